@@ -0,0 +1,131 @@
+/* Read accelerator: an immutable sorted copy of the keys of a list.
+ *
+ * Lookups binary search the copy, a cache-aligned array, instead of chasing
+ * next pointers, as long as no update started since the copy was taken;
+ * otherwise they fall back to the list. Every update of the list counts
+ * itself in started before it changes the list and in finished after, so a
+ * copy taken while the two counts were equal and started did not move
+ * reflects the list exactly, up to the next update.
+ *
+ * Copies are rebuilt lazily: a thread that found the copy stale threshold
+ * times takes a new one and publishes it with a pointer swap, and the old
+ * one is retired through the reclamation scheme (RCU-style). The cost of a
+ * rebuild, one traversal, is thus amortized over threshold traversals.
+ * Lookups must be called between reclaim_enter and reclaim_exit.
+ */
+#ifndef _ACCEL_H_
+#define _ACCEL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "list.h"
+#include "reclaim.h"
+#include "stats.h"
+#include "utils.h"
+
+/* keys per block, the unit of the final vector comparison: a cache line */
+#define ACCEL_BLOCK 8
+
+/* hazard pointer slot protecting the copy during a lookup */
+#define ACCEL_HP 0
+
+typedef struct accel_snap {
+    uint64_t stamp;  /* value of started the copy reflects */
+    size_t nblocks;  /* at least 1; the last block is padded with VAL_MAX */
+    ALIGNED(64) val_t keys[];
+} accel_snap_t;
+
+typedef struct accel {
+    accel_snap_t *snap; /* NULL until the first rebuild */
+    uint32_t threshold; /* stale lookups per rebuild, 0 when disabled */
+    uint32_t building;  /* 1 while a thread rebuilds the copy */
+    uint64_t rebuilds;  /* copies published */
+    /* written by every update, kept away from the fields above */
+    uint64_t started ALIGNED(64);
+    uint64_t finished;
+} ALIGNED(64) accel_t;
+
+/* GCC vector of the keys of a block; compiled to SSE, AVX2, AVX-512 or NEON
+ * depending on the target.
+ */
+typedef val_t accel_vec_t __attribute__((vector_size(ACCEL_BLOCK * sizeof(val_t))));
+
+/* stale lookups of the calling thread since it last tried a rebuild */
+extern __thread uint32_t accel_stale;
+
+void accel_init(accel_t *a, uint32_t threshold);
+void accel_destroy(accel_t *a);
+
+/* take a new copy of the keys of the_list and publish it, unless another
+ * thread is doing it or the list is updated meanwhile.
+ */
+void accel_rebuild(accel_t *a, list_t *the_list);
+
+/* to be called around every update of the list */
+static inline void accel_update_begin(accel_t *a)
+{
+    if (a->threshold)
+        __atomic_fetch_add(&a->started, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline void accel_update_end(accel_t *a)
+{
+    if (a->threshold)
+        __atomic_fetch_add(&a->finished, 1, __ATOMIC_RELEASE);
+}
+
+/* return true if key is within the sorted copy. A branchless binary search
+ * over the first key of each block, which prefetches both blocks the next
+ * step may probe, finds the only block that may hold key; all the keys of
+ * that block are then compared at once.
+ */
+static inline bool accel_search(const accel_snap_t *s, val_t key)
+{
+    const val_t *keys = s->keys;
+    size_t base = 0, n = s->nblocks;
+    while (n > 1) {
+        size_t half = n / 2;
+        __builtin_prefetch(&keys[(base + half / 2) * ACCEL_BLOCK]);
+        __builtin_prefetch(&keys[(base + half + half / 2) * ACCEL_BLOCK]);
+        base = keys[(base + half) * ACCEL_BLOCK] <= key ? base + half : base;
+        n -= half;
+    }
+
+    accel_vec_t block = *(const accel_vec_t *) &keys[base * ACCEL_BLOCK];
+    accel_vec_t eq = block == key;
+    val_t any = 0;
+    for (int i = 0; i < ACCEL_BLOCK; i++)
+        any |= eq[i];
+    return any != 0;
+}
+
+/* look up key in the copy.
+ * @return 1 if present, 0 if absent, -1 if there is no up-to-date copy
+ */
+static inline int accel_lookup(accel_t *a, val_t key)
+{
+    accel_snap_t *s = reclaim_protect(ACCEL_HP, (void *volatile *) &a->snap);
+    if (!s)
+        return -1;
+    if (s->stamp != __atomic_load_n(&a->started, __ATOMIC_SEQ_CST)) {
+        STAT_INC(snap_stale);
+        return -1;
+    }
+    STAT_INC(snap_hits);
+    return accel_search(s, key);
+}
+
+/* to be called, outside of reclaim_enter/reclaim_exit, after a lookup that
+ * had to fall back to the list
+ */
+static inline void accel_missed(accel_t *a, list_t *the_list)
+{
+    if (a->threshold && ++accel_stale >= a->threshold) {
+        accel_stale = 0;
+        accel_rebuild(a, the_list);
+    }
+}
+
+#endif /* _ACCEL_H_ */
@@ -0,0 +1,50 @@
+/* Per-thread slab allocator for list nodes.
+ *
+ * Each thread carves nodes out of its own slabs, so a thread that inserts a
+ * node also first-touches its memory, and allocation never synchronizes with
+ * other threads. A freed node goes to the free list of the freeing thread.
+ * Slots are sized so that a node never straddles two cache lines unless it
+ * is larger than one.
+ */
+#ifndef _ALLOC_H_
+#define _ALLOC_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* slabs are aligned to their size, which is the size of a huge page */
+#define SLAB_SIZE (2UL << 20)
+
+/* the largest node the allocator serves */
+#define NODE_MAX_SIZE 1024
+
+typedef struct alloc_stats {
+    uint64_t allocs; /* nodes handed out by node_alloc */
+    uint64_t frees;  /* nodes given back with node_free */
+    uint64_t slabs;  /* slabs mapped by all threads */
+    size_t size;     /* size of the largest node requested */
+    size_t slot;     /* bytes actually used for such a node */
+} alloc_stats_t;
+
+/* back the slabs mapped from now on with transparent huge pages */
+void alloc_huge_pages(bool enable);
+
+void *node_alloc(size_t size);
+void node_free(void *node);
+
+/* like node_alloc, but never reuse a freed slot: nodes allocated in a row by
+ * a thread are adjacent in memory, in the order they were allocated, except
+ * where a slab ends. Meant for bulk loads, so that the list is laid out in
+ * the order it is traversed.
+ */
+void *node_alloc_sequential(size_t size);
+
+void alloc_stats(alloc_stats_t *stats);
+
+/* unmap the slabs of every thread, once no node is in use anymore and no
+ * other thread allocates; the allocator starts over afterwards.
+ */
+void alloc_release(void);
+
+#endif /* _ALLOC_H_ */
@@ -21,6 +21,10 @@
 #define CAS_U32(a, b, c) CAS_PTR((uint32_t *) a, b, c)
 #define CAS_U64(a, b, c) CAS_PTR((uint64_t *) a, b, c)
 
+/* Atomic exchange, returns the previous value */
+#define SWAP_PTR(a, b) __atomic_exchange_n(a, b, __ATOMIC_SEQ_CST)
+#define SWAP_U32(a, b) SWAP_PTR((uint32_t *) a, b)
+
 /* Fetch-and-increment */
 #define FAI_U8(a) __atomic_fetch_add(a, 1, __ATOMIC_RELAXED)
 #define FAI_U16(a) FAI_U8(a)
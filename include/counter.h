@@ -0,0 +1,54 @@
+/* Striped counters, for the size of the lists.
+ *
+ * A single shared count takes a cache miss on every update at high thread
+ * counts. A striped counter spreads the count over cache-line sized stripes
+ * instead: every thread is given a stripe the first time it counts, round
+ * robin, and only updates that one, so threads do not share stripes as long
+ * as there are at most COUNTER_STRIPES of them. Reading the counter sums the
+ * stripes; the sum is exact when no update is under way, but is not
+ * linearizable otherwise, as the stripes are not read at the same time.
+ */
+#ifndef _COUNTER_H_
+#define _COUNTER_H_
+
+#include <stdint.h>
+
+#include "utils.h"
+
+#define COUNTER_STRIPES 64
+
+typedef struct counter {
+    struct {
+        int64_t count;
+    } ALIGNED(64) stripes[COUNTER_STRIPES];
+} counter_t;
+
+/* stripe of the calling thread, -1 until it first counts */
+extern __thread int counter_stripe;
+
+/* give the calling thread its stripe */
+int counter_assign(void);
+
+static inline void counter_init(counter_t *c, int64_t count)
+{
+    for (int i = 0; i < COUNTER_STRIPES; i++)
+        c->stripes[i].count = 0;
+    c->stripes[0].count = count;
+}
+
+static inline void counter_add(counter_t *c, int64_t n)
+{
+    int s = counter_stripe >= 0 ? counter_stripe : counter_assign();
+    /* the stripe may be shared with more than COUNTER_STRIPES threads */
+    __atomic_fetch_add(&c->stripes[s].count, n, __ATOMIC_RELAXED);
+}
+
+static inline int64_t counter_read(counter_t *c)
+{
+    int64_t sum = 0;
+    for (int i = 0; i < COUNTER_STRIPES; i++)
+        sum += __atomic_load_n(&c->stripes[i].count, __ATOMIC_RELAXED);
+    return sum;
+}
+
+#endif /* _COUNTER_H_ */
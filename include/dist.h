@@ -0,0 +1,130 @@
+/* Key distributions of the benchmark workload.
+ *
+ * Keys are drawn from [0, range) for any range, not only powers of two: a
+ * 32-bit random number r is scaled with (r * range) >> 32, so the hot loop
+ * needs no division. Skewed distributions sample a precomputed alias table
+ * (Walker, Vose) in constant time.
+ */
+#ifndef _DIST_H_
+#define _DIST_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "list.h"
+#include "random.h"
+#include "utils.h"
+
+#define DIST_UNIFORM 0    /* uniformly random keys */
+#define DIST_CLUSTERED 1  /* random keys in a window sliding with each op */
+#define DIST_SEQUENTIAL 2 /* each thread walks the key range in order */
+#define DIST_MONOTONIC 3  /* all threads share one increasing key counter */
+#define DIST_ZIPF 4       /* Zipf-skewed popularity, hot keys spread out */
+#define DIST_HOTSPOT 5    /* a share of the ops on a share of the keys */
+#define DIST_LATEST 6     /* inserts new keys, the others hit recent ones */
+
+/* size of the window of the clustered distribution, a power of 2 */
+#define CLUSTER_WIDTH 64
+
+#define DEFAULT_ZIPF_THETA 0.99
+#define DEFAULT_HOT_OPS 80
+#define DEFAULT_HOT_KEYS 20
+
+/* one column of an alias table: outcome i is kept if the high half of the
+ * random number is below prob, and replaced with alias otherwise
+ */
+typedef struct alias {
+    uint32_t prob;
+    uint32_t alias;
+} alias_t;
+
+typedef struct dist {
+    int type;
+    uint32_t range;
+    double theta;     /* zipf, latest: skew of the popularity */
+    double hot_keys;  /* hotspot: share of the keys, in percent */
+    uint32_t hot_ops; /* hotspot: share of the ops, scaled to 2^32 */
+    uint32_t hot_lo, hot_n; /* hotspot: the hot keys */
+    alias_t *table;   /* zipf: over keys; latest: over distances */
+    uint32_t counter ALIGNED(64); /* monotonic, latest: last key handed out */
+} dist_t;
+
+/* parse a distribution given as name[:param[:param]], e.g. zipf:0.8 or
+ * hotspot:90:10.
+ * @return 0 on success, -1 if the specification is invalid
+ */
+int dist_parse(dist_t *d, const char *spec);
+
+/* set up the key range and the tables of the distribution */
+void dist_init(dist_t *d, uint32_t range);
+
+void dist_destroy(dist_t *d);
+
+/* scale a 32-bit random number to [0, n) */
+static inline uint32_t dist_scale(uint32_t r, uint32_t n)
+{
+    return (uint32_t) (((uint64_t) r * n) >> 32);
+}
+
+static inline uint32_t dist_uniform(const dist_t *d)
+{
+    return dist_scale(my_random(&seeds[0], &seeds[1], &seeds[2]), d->range);
+}
+
+static inline uint32_t alias_sample(const alias_t *table, uint32_t n, uint64_t r)
+{
+    uint32_t i = dist_scale((uint32_t) r, n);
+    return (uint32_t) (r >> 32) < table[i].prob ? i : table[i].alias;
+}
+
+/* hand out the next key of the shared counter, wrapping at the range */
+static inline uint32_t dist_count(dist_t *d)
+{
+    uint32_t c = __atomic_load_n(&d->counter, __ATOMIC_RELAXED), n;
+    do {
+        n = c + 1 == d->range ? 0 : c + 1;
+    } while (!__atomic_compare_exchange_n(&d->counter, &c, n, true,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return n;
+}
+
+/* generate the key of the next operation; cursor holds the position of the
+ * thread in the key range, and insert tells if the key is for list_add.
+ */
+static inline val_t dist_next(dist_t *d, uint32_t *cursor, bool insert)
+{
+    uint64_t r = my_random(&seeds[0], &seeds[1], &seeds[2]);
+    uint32_t k;
+    switch (d->type) {
+    case DIST_CLUSTERED:
+        if (++*cursor == d->range)
+            *cursor = 0;
+        k = *cursor + (r & (CLUSTER_WIDTH - 1));
+        while (k >= d->range)
+            k -= d->range;
+        return k;
+    case DIST_SEQUENTIAL:
+        if (++*cursor == d->range)
+            *cursor = 0;
+        return *cursor;
+    case DIST_MONOTONIC:
+        return dist_count(d);
+    case DIST_ZIPF:
+        return alias_sample(d->table, d->range, r);
+    case DIST_HOTSPOT:
+        if ((uint32_t) (r >> 32) < d->hot_ops)
+            return d->hot_lo + dist_scale((uint32_t) r, d->hot_n);
+        k = dist_scale((uint32_t) r, d->range - d->hot_n);
+        return k < d->hot_lo ? k : k + d->hot_n;
+    case DIST_LATEST:
+        if (insert)
+            return dist_count(d);
+        k = alias_sample(d->table, d->range, r); /* distance to the latest */
+        uint32_t latest = __atomic_load_n(&d->counter, __ATOMIC_RELAXED);
+        return latest >= k ? latest - k : latest + d->range - k;
+    default:
+        return dist_scale((uint32_t) r, d->range);
+    }
+}
+
+#endif /* _DIST_H_ */
@@ -0,0 +1,49 @@
+/* List dumps: the keys of a list, with their payloads, saved to a file from
+ * which the list can be rebuilt in a single pass.
+ *
+ * A dump file holds a header, the keys in ascending order, then the payload
+ * of every key (0 for the lists without payloads). The keys are mapped into
+ * memory and handed over as is to the bulk load of the list, so loading a
+ * dump costs a sequential read of the file and one node allocation per key.
+ * All fields are in the byte order of the saving machine.
+ */
+#ifndef _DUMP_H_
+#define _DUMP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "list.h"
+
+#define DUMP_MAGIC "LLDUMP01"
+
+typedef struct dump_header {
+    char magic[8];  /* DUMP_MAGIC, not terminated */
+    uint64_t count; /* number of keys */
+} dump_header_t;
+
+/* a memory-mapped dump file */
+typedef struct dump {
+    void *map;
+    size_t size;
+    uint64_t count;
+    const val_t *keys;        /* count keys, in ascending order */
+    const uint64_t *payloads; /* count payloads, in the order of the keys */
+} dump_t;
+
+/* map the dump file at path and check it.
+ * @return 0 on success, -1 with a message on stderr
+ */
+int dump_open(dump_t *d, const char *path);
+void dump_close(dump_t *d);
+
+/* write n keys, in ascending order, and their payloads (or zeros, if
+ * payloads is NULL) to a dump file at path.
+ * @return 0 on success, -1 with a message on stderr
+ */
+int dump_write(const char *path,
+               const val_t *keys,
+               const uint64_t *payloads,
+               uint64_t n);
+
+#endif /* _DUMP_H_ */
@@ -0,0 +1,659 @@
+/* Harris' lock-free sorted linked list.
+ *
+ * The operations work on the part of a list between two nodes, head and
+ * tail, which must never be removed: the sentinels of the lock-free list, or
+ * a bucket node and the end of the list in the split-ordered hash set. They
+ * must be called between reclaim_enter and reclaim_exit.
+ */
+#ifndef _HARRIS_H_
+#define _HARRIS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "alloc.h"
+#include "list.h"
+#include "reclaim.h"
+#include "stats.h"
+#if defined(LIST_RANGE)
+#include "snapshot.h"
+#endif
+
+struct node {
+    val_t data;
+    struct node *next;
+#if defined(LIST_MAP)
+    payload_t payload; /* never changes, see harris_put */
+#endif
+#if defined(LIST_RANGE)
+    uint64_t ins_ts, del_ts; /* see snapshot.h */
+#endif
+};
+
+/* The following functions handle the low-order mark bit that indicates
+ * whether a node is logically deleted (1) or not (0).
+ *  - is_marked_ref returns whether it is marked,
+ *  - (un)set_marked changes the mark,
+ *  - get_(un)marked_ref sets the mark before returning the node.
+ */
+static inline bool is_marked_ref(void *i)
+{
+    return (bool) ((uintptr_t) i & 0x1L);
+}
+
+static inline void *get_unmarked_ref(void *w)
+{
+    return (void *) ((uintptr_t) w & ~0x1L);
+}
+
+static inline void *get_marked_ref(void *w)
+{
+    return (void *) ((uintptr_t) w | 0x1L);
+}
+
+/* hazard pointer slot protecting the starting node of the *_from operations */
+#define HARRIS_HP_START 3
+
+/* Timestamps for range queries: a node found in the list must have its
+ * insertion timestamped before the operation relies on it, and likewise for
+ * the removal of a node found marked. Removed nodes are reported to the range
+ * queries that may need them before they are unlinked.
+ */
+#if defined(LIST_RANGE)
+static inline void harris_inserted(node_t *node)
+{
+    snap_stamp(&node->ins_ts);
+}
+
+static inline void harris_removed(node_t *node)
+{
+    snap_stamp(&node->del_ts);
+}
+
+static inline void harris_unlinking(node_t *node)
+{
+    if (snap_reporting())
+        snap_report(node->data, node->ins_ts, node->del_ts);
+}
+#else
+static inline void harris_inserted(node_t *node) {}
+static inline void harris_removed(node_t *node) {}
+static inline void harris_unlinking(node_t *node) {}
+#endif
+
+#if RECLAIM == RECLAIM_HP
+/* Hazard pointers only protect a node as long as it is still reachable when
+ * the hazard is published, which does not hold for the nodes of a chain that
+ * Harris' search unlinks with a single CAS. Use Michael's variant instead: it
+ * validates every step and unlinks marked nodes one at a time.
+ *
+ * harris_search_from looks for value val, starting from node start, it
+ *  - returns right_node owning val (if present) or its immediately higher
+ *    value present in the list (otherwise) and
+ *  - sets the left_node to the node owning the value immediately lower than
+ *    val.
+ * Both nodes are protected by hazard pointers when it returns. start must
+ * own a value lower than val and be protected by HARRIS_HP_START; the search
+ * falls back to head if start was removed.
+ */
+static inline node_t *harris_search_from(node_t *head,
+                                         node_t *start,
+                                         node_t *tail,
+                                         val_t val,
+                                         node_t **left_node)
+{
+    int hp_left, hp_right, hp_next;
+retry:
+    hp_left = 0, hp_right = 1, hp_next = 2;
+    node_t *left = start; /* head and tail are never retired */
+    node_t *right = reclaim_protect(hp_right, (void *volatile *) &left->next);
+    if (is_marked_ref(right)) {
+        STAT_INC(search_retries);
+        start = head;
+        goto retry;
+    }
+    while (right != tail) {
+        STAT_INC(traversed);
+        node_t *right_next =
+            reclaim_protect(hp_next, (void *volatile *) &right->next);
+        if (left->next != right) {
+            STAT_INC(search_retries);
+            goto retry;
+        }
+
+        if (is_marked_ref(right_next)) {
+            harris_removed(right);
+            harris_unlinking(right);
+            right_next = get_unmarked_ref(right_next);
+            if (CAS_PTR(&(left->next), right, right_next) != right) {
+                STAT_INC(search_retries);
+                goto retry;
+            }
+            STAT_INC(marked_snipped);
+            reclaim_retire(right);
+
+            int hp = hp_right;
+            hp_right = hp_next;
+            hp_next = hp;
+        } else {
+            if (right->data >= val)
+                break;
+            left = right;
+
+            int hp = hp_left;
+            hp_left = hp_right;
+            hp_right = hp_next;
+            hp_next = hp;
+        }
+        right = right_next;
+    }
+    *left_node = left;
+    return right;
+}
+#else
+/* harris_search_from looks for value val, starting from node start, it
+ *  - returns right_node owning val (if present) or its immediately higher
+ *    value present in the list (otherwise) and
+ *  - sets the left_node to the node owning the value immediately lower than
+ *    val.
+ * Encountered nodes that are marked as logically deleted are physically removed
+ * from the list and handed over to the reclamation scheme. start must own a
+ * value lower than val; the search falls back to head if start was removed.
+ */
+static inline node_t *harris_search_from(node_t *head,
+                                         node_t *start,
+                                         node_t *tail,
+                                         val_t val,
+                                         node_t **left_node)
+{
+    node_t *left_node_next, *right_node;
+    left_node_next = right_node = NULL;
+    while (1) {
+        node_t *t = start;
+        node_t *t_next = start->next;
+        if (is_marked_ref(t_next)) {
+            t = start = head;
+            t_next = head->next;
+        }
+        while (is_marked_ref(t_next) || (t->data < val)) {
+            if (!is_marked_ref(t_next)) {
+                (*left_node) = t;
+                left_node_next = t_next;
+            } else {
+                STAT_INC(marked_skipped);
+                harris_removed(t);
+            }
+            t = get_unmarked_ref(t_next);
+            if (t == tail)
+                break;
+            STAT_INC(traversed);
+            t_next = t->next;
+        }
+        right_node = t;
+
+        if (left_node_next == right_node) {
+            if (!is_marked_ref(right_node->next))
+                return right_node;
+        } else {
+#if defined(LIST_RANGE)
+            for (node_t *n = left_node_next; n != right_node;
+                 n = get_unmarked_ref(n->next))
+                harris_unlinking(n);
+#endif
+            if (CAS_PTR(&((*left_node)->next), left_node_next, right_node) ==
+                left_node_next) {
+                /* the marked chain is ours now, retire it */
+                for (node_t *n = left_node_next; n != right_node;) {
+                    node_t *next = get_unmarked_ref(n->next);
+                    STAT_INC(marked_snipped);
+                    reclaim_retire(n);
+                    n = next;
+                }
+                if (!is_marked_ref(right_node->next))
+                    return right_node;
+            }
+        }
+        STAT_INC(search_retries);
+    }
+}
+#endif
+
+static inline node_t *harris_search(node_t *head,
+                                    node_t *tail,
+                                    val_t val,
+                                    node_t **left_node)
+{
+    return harris_search_from(head, head, tail, val, left_node);
+}
+
+/* The *_from operations start from *start instead of head, and set it to the
+ * node before val when they return, so that a sorted batch of values can be
+ * handled in a single pass. *start must own a value lower than val, and under
+ * hazard pointers be protected by HARRIS_HP_START.
+ */
+
+/* return the node after head owning value val, NULL if there is none; under
+ * hazard pointers, the node is protected until the next operation.
+ */
+static inline node_t *harris_find_from(node_t *head,
+                                       node_t **start,
+                                       node_t *tail,
+                                       val_t val)
+{
+#if RECLAIM == RECLAIM_HP
+    /* a traversal without validation could step on a freed node */
+    node_t *right = harris_search_from(head, *start, tail, val, start);
+    if (right == tail || right->data != val)
+        return NULL;
+    harris_inserted(right);
+    return right;
+#else
+    /* a removed node may not lead to the nodes inserted after its removal */
+    node_t *first = (*start)->next;
+    if (is_marked_ref(first)) {
+        *start = head;
+        first = head->next;
+    }
+    node_t *iterator = get_unmarked_ref(first);
+    while (iterator != tail) {
+        STAT_INC(traversed);
+        node_t *next = iterator->next;
+        if (!is_marked_ref(next) && iterator->data >= val) {
+            /* either we found it, or found the first larger element */
+            if (iterator->data != val)
+                return NULL;
+            harris_inserted(iterator);
+            return iterator;
+        }
+        if (is_marked_ref(next))
+            STAT_INC(marked_skipped);
+        if (iterator->data == val)
+            harris_removed(iterator);
+        else if (!is_marked_ref(next))
+            *start = iterator;
+
+        /* always get unmarked pointer */
+        iterator = get_unmarked_ref(next);
+    }
+    return NULL;
+#endif
+}
+
+/* return true if there is a node after head owning value val. */
+static inline bool harris_contains_from(node_t *head,
+                                        node_t **start,
+                                        node_t *tail,
+                                        val_t val)
+{
+    return harris_find_from(head, start, tail, val) != NULL;
+}
+
+static inline bool harris_contains(node_t *head, node_t *tail, val_t val)
+{
+    return harris_contains_from(head, &head, tail, val);
+}
+
+#if RECLAIM != RECLAIM_HP
+/* searches that harris_contains_multi advances together at most */
+#define HARRIS_MULTI_MAX 32
+
+/* look up the n values of vals after head, n <= HARRIS_MULTI_MAX, and store
+ * in found[i] whether vals[i] is present, as harris_contains does.
+ *
+ * A single traversal is a chain of dependent cache misses. Here every search
+ * is a cursor that the loop moves by one node in turn, prefetching the node
+ * it moves to, so the misses of up to n searches are in flight at once. A
+ * search leaves the round-robin as soon as it is over. Hazard pointers could
+ * not protect the nodes of so many searches.
+ * @return the number of values found
+ */
+static inline int harris_contains_multi(node_t *head,
+                                        node_t *tail,
+                                        const val_t *vals,
+                                        int n,
+                                        bool *found)
+{
+    node_t *cursors[HARRIS_MULTI_MAX];
+    uint8_t active[HARRIS_MULTI_MAX];
+    node_t *first = get_unmarked_ref(head->next);
+    __builtin_prefetch(first);
+    for (int i = 0; i < n; i++) {
+        cursors[i] = first;
+        active[i] = i;
+    }
+
+    int hits = 0;
+    while (n > 0) {
+        for (int k = 0; k < n;) {
+            int i = active[k];
+            node_t *node = cursors[i];
+            if (node == tail) {
+                found[i] = false;
+                active[k] = active[--n];
+                continue;
+            }
+            STAT_INC(traversed);
+            node_t *next = node->next;
+            if (!is_marked_ref(next) && node->data >= vals[i]) {
+                found[i] = node->data == vals[i];
+                if (found[i]) {
+                    harris_inserted(node);
+                    hits++;
+                }
+                active[k] = active[--n];
+                continue;
+            }
+            if (is_marked_ref(next)) {
+                STAT_INC(marked_skipped);
+                if (node->data == vals[i])
+                    harris_removed(node);
+            }
+            cursors[i] = get_unmarked_ref(next);
+            __builtin_prefetch(cursors[i]);
+            k++;
+        }
+    }
+    return hits;
+}
+#endif
+
+#if defined(LIST_RANGE)
+/* a node reached after the snapshot was taken, whose next pointer was next:
+ * return true if it belongs to the snapshot.
+ */
+static inline bool harris_visible(node_t *node, node_t *next, uint64_t ts)
+{
+    if (snap_stamp(&node->ins_ts) > ts)
+        return false;
+    return !is_marked_ref(next) || snap_stamp(&node->del_ts) > ts;
+}
+
+/* collect the values within [lo, hi] of the nodes after head that belong to
+ * the snapshot taken at ts, storing at most max of them in buf.
+ * @return the number of values found
+ */
+static inline int harris_collect(node_t *head,
+                                 node_t *tail,
+                                 val_t lo,
+                                 val_t hi,
+                                 uint64_t ts,
+                                 val_t *buf,
+                                 int max)
+{
+    int n = 0;
+#if RECLAIM == RECLAIM_HP
+    /* same traversal as Michael's search; after a restart, the nodes already
+     * looked at are skipped.
+     */
+    int hp_left, hp_right, hp_next;
+retry:
+    hp_left = 0, hp_right = 1, hp_next = 2;
+    node_t *left = head;
+    node_t *right = reclaim_protect(hp_right, (void *volatile *) &left->next);
+    while (right != tail) {
+        node_t *right_next =
+            reclaim_protect(hp_next, (void *volatile *) &right->next);
+        if (left->next != right)
+            goto retry;
+
+        if (is_marked_ref(right_next)) {
+            harris_removed(right);
+            harris_unlinking(right);
+            right_next = get_unmarked_ref(right_next);
+            if (CAS_PTR(&(left->next), right, right_next) != right)
+                goto retry;
+            reclaim_retire(right);
+
+            int hp = hp_right;
+            hp_right = hp_next;
+            hp_next = hp;
+        } else {
+            if (right->data > hi)
+                break;
+            if (right->data >= lo) {
+                if (harris_visible(right, right_next, ts)) {
+                    if (n < max)
+                        buf[n] = right->data;
+                    n++;
+                }
+                lo = right->data + 1;
+            }
+            left = right;
+
+            int hp = hp_left;
+            hp_left = hp_right;
+            hp_right = hp_next;
+            hp_next = hp;
+        }
+        right = right_next;
+    }
+#else
+    /* marked nodes are followed, not unlinked: keys only increase along
+     * next pointers, and the timestamps tell which nodes to keep.
+     */
+    node_t *iterator = get_unmarked_ref(head->next);
+    while (iterator != tail && iterator->data <= hi) {
+        node_t *next = iterator->next;
+        if (iterator->data >= lo && harris_visible(iterator, next, ts)) {
+            if (n < max)
+                buf[n] = iterator->data;
+            n++;
+            /* a node and the copy replacing it may both be visible */
+            lo = iterator->data + 1;
+        }
+        iterator = get_unmarked_ref(next);
+    }
+#endif
+    return n;
+}
+#endif
+
+static inline node_t *init_node(node_t *node, val_t val, node_t *next)
+{
+    node->data = val;
+    node->next = next;
+#if defined(LIST_MAP)
+    node->payload = 0;
+#endif
+#if defined(LIST_RANGE)
+    node->ins_ts = node->del_ts = 0;
+#endif
+    return node;
+}
+
+static inline node_t *new_node(val_t val, node_t *next)
+{
+    return init_node(node_alloc(sizeof(node_t)), val, next);
+}
+
+/* insert a new node owning value val after head.
+ * @return true if succeed; *node is set to the new node, or to the node
+ * already owning val.
+ */
+static inline bool harris_insert_from(node_t *head,
+                                      node_t **start,
+                                      node_t *tail,
+                                      val_t val,
+                                      node_t **node)
+{
+    node_t *left = NULL;
+    node_t *new_elem = NULL;
+    while (1) {
+        node_t *right = harris_search_from(head, *start, tail, val, &left);
+        if (right != tail && right->data == val) {
+            node_free(new_elem); /* allocated by a failed attempt */
+            harris_inserted(right);
+            *start = left;
+            *node = right;
+            return false;
+        }
+
+        /* only allocate once we know the value is absent */
+        if (!new_elem)
+            new_elem = new_node(val, right);
+        else
+            new_elem->next = right;
+        if (CAS_PTR(&(left->next), right, new_elem) == right) {
+            harris_inserted(new_elem);
+            *start = left;
+            *node = new_elem;
+            return true;
+        }
+        STAT_INC(cas_failures);
+    }
+}
+
+static inline bool harris_insert(node_t *head,
+                                 node_t *tail,
+                                 val_t val,
+                                 node_t **node)
+{
+    return harris_insert_from(head, &head, tail, val, node);
+}
+
+/* The deletion is logical and consists of setting the node mark bit to 1.
+ * The node is then unlinked, either right away or by a later harris_search,
+ * and retired by whoever unlinked it.
+ */
+static inline bool harris_remove_from(node_t *head,
+                                      node_t **start,
+                                      node_t *tail,
+                                      val_t val)
+{
+    node_t *left = NULL;
+    while (1) {
+        node_t *right = harris_search_from(head, *start, tail, val, &left);
+        /* check if we found our node */
+        if ((right == tail) || (right->data != val)) {
+            *start = left;
+            return false;
+        }
+
+        node_t *right_succ = right->next;
+        if (!is_marked_ref(right_succ)) {
+            harris_inserted(right); /* its removal must come later */
+            if (CAS_PTR(&(right->next), right_succ,
+                        get_marked_ref(right_succ)) == right_succ) {
+                harris_removed(right);
+                harris_unlinking(right);
+                if (CAS_PTR(&(left->next), right, right_succ) == right) {
+                    STAT_INC(marked_snipped);
+                    reclaim_retire(right);
+                } else { /* somebody changed left; let the search unlink it */
+                    STAT_INC(cas_failures);
+                    harris_search(head, tail, val, &left);
+                }
+                *start = left;
+                return true;
+            }
+        }
+        STAT_INC(cas_failures);
+    }
+}
+
+static inline bool harris_remove(node_t *head, node_t *tail, val_t val)
+{
+    return harris_remove_from(head, &head, tail, val);
+}
+
+#if defined(LIST_MAP)
+/* modes of harris_put */
+#define HARRIS_PUT 0           /* insert val, or replace its payload */
+#define HARRIS_PUT_IF_ABSENT 1 /* insert val only */
+#define HARRIS_REPLACE 2       /* replace a given payload only */
+
+/* results of harris_put */
+#define HARRIS_ABSENT 0   /* val was absent, and was left so */
+#define HARRIS_INSERTED 1 /* val was absent, and was inserted */
+#define HARRIS_FOUND 2    /* val was present, its payload was left as is */
+#define HARRIS_REPLACED 3 /* val was present, its payload was replaced */
+
+/* map value val to payload after head, as told by mode. For HARRIS_REPLACE,
+ * *old holds the expected payload; if val is present, *old is set to the
+ * payload it had.
+ *
+ * The payload of a node never changes. To replace it, the node is marked
+ * with a pointer to a copy owning the new payload instead of a pointer to
+ * its successor: a single CAS removes the node and inserts the copy, which
+ * traversals reach through the marked node until it is unlinked. A
+ * concurrent removal or replacement of the node makes the CAS fail.
+ * @return one of HARRIS_ABSENT, HARRIS_INSERTED, HARRIS_FOUND and
+ * HARRIS_REPLACED
+ */
+static inline int harris_put(node_t *head,
+                             node_t *tail,
+                             val_t val,
+                             payload_t payload,
+                             int mode,
+                             payload_t *old)
+{
+    node_t *left = NULL;
+    node_t *new_elem = NULL;
+    while (1) {
+        node_t *right = harris_search(head, tail, val, &left);
+        if (right == tail || right->data != val) {
+            if (mode == HARRIS_REPLACE) {
+                node_free(new_elem);
+                return HARRIS_ABSENT;
+            }
+            if (!new_elem)
+                new_elem = new_node(val, right);
+            else
+                new_elem->next = right;
+            new_elem->payload = payload;
+            if (CAS_PTR(&(left->next), right, new_elem) == right) {
+                harris_inserted(new_elem);
+                return HARRIS_INSERTED;
+            }
+            STAT_INC(cas_failures);
+            continue;
+        }
+
+        payload_t current = right->payload;
+        if (mode == HARRIS_PUT_IF_ABSENT ||
+            (mode == HARRIS_REPLACE && current != *old)) {
+            node_free(new_elem);
+            harris_inserted(right);
+            *old = current;
+            return HARRIS_FOUND;
+        }
+
+        node_t *right_succ = right->next;
+        if (!is_marked_ref(right_succ)) {
+            if (!new_elem)
+                new_elem = new_node(val, right_succ);
+            else
+                new_elem->next = right_succ;
+            new_elem->payload = payload;
+            harris_inserted(right); /* its removal must come later */
+#if defined(LIST_RANGE)
+            /* date the copy before the removal of the node, so that no
+             * snapshot misses the key; the range queries that see both
+             * nodes count it once.
+             */
+            new_elem->ins_ts = __atomic_load_n(&snap_clock, __ATOMIC_SEQ_CST);
+#endif
+            if (CAS_PTR(&(right->next), right_succ,
+                        get_marked_ref(new_elem)) == right_succ) {
+                harris_removed(right);
+                harris_unlinking(right);
+                if (CAS_PTR(&(left->next), right, new_elem) == right) {
+                    STAT_INC(marked_snipped);
+                    reclaim_retire(right);
+                } else { /* somebody changed left; let the search unlink it */
+                    STAT_INC(cas_failures);
+                    harris_search(head, tail, val, &left);
+                }
+                *old = current;
+                return HARRIS_REPLACED;
+            }
+#if defined(LIST_RANGE)
+            new_elem->ins_ts = 0;
+#endif
+        }
+        STAT_INC(cas_failures);
+    }
+}
+#endif
+
+#endif /* _HARRIS_H_ */
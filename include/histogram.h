@@ -0,0 +1,84 @@
+#ifndef _HISTOGRAM_H_
+#define _HISTOGRAM_H_
+
+#include <stdint.h>
+#include <string.h>
+
+/* Log-linear histogram of 64-bit samples, in the spirit of HdrHistogram:
+ * every power of two is split into HIST_SUB linear buckets, so a sample is
+ * recorded with a relative error below 1 / HIST_SUB, and recording it takes
+ * a count-leading-zeros and an increment. Histograms are meant to be filled
+ * by a single thread and merged afterwards.
+ */
+#define HIST_SUB_BITS 4
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+typedef struct {
+    uint64_t count;
+    uint64_t max;
+    uint64_t buckets[HIST_BUCKETS];
+} hist_t;
+
+/* samples below HIST_SUB have a bucket each; above, the bucket is given by
+ * the position of the most significant bit and the HIST_SUB_BITS bits below
+ */
+static inline int hist_bucket(uint64_t v)
+{
+    if (v < HIST_SUB)
+        return (int) v;
+    int shift = 63 - __builtin_clzll(v) - HIST_SUB_BITS;
+    return ((shift + 1) << HIST_SUB_BITS) + (int) ((v >> shift) & (HIST_SUB - 1));
+}
+
+/* lowest sample that falls in bucket b */
+static inline uint64_t hist_bucket_low(int b)
+{
+    if (b < HIST_SUB)
+        return b;
+    int shift = (b >> HIST_SUB_BITS) - 1;
+    return (uint64_t) (HIST_SUB | (b & (HIST_SUB - 1))) << shift;
+}
+
+static inline void hist_init(hist_t *h)
+{
+    memset(h, 0, sizeof(hist_t));
+}
+
+static inline void hist_record(hist_t *h, uint64_t v)
+{
+    h->buckets[hist_bucket(v)]++;
+    h->count++;
+    if (v > h->max)
+        h->max = v;
+}
+
+static inline void hist_merge(hist_t *dst, const hist_t *src)
+{
+    for (int b = 0; b < HIST_BUCKETS; b++)
+        dst->buckets[b] += src->buckets[b];
+    dst->count += src->count;
+    if (src->max > dst->max)
+        dst->max = src->max;
+}
+
+/* value below which lie p percent of the samples, as the lower bound of its
+ * bucket (never above the maximum); 0 for an empty histogram
+ */
+static inline uint64_t hist_percentile(const hist_t *h, double p)
+{
+    uint64_t rank = (uint64_t) (h->count * p / 100.0);
+    if (rank >= h->count)
+        return h->max;
+    uint64_t seen = 0;
+    for (int b = 0; b < HIST_BUCKETS; b++) {
+        seen += h->buckets[b];
+        if (seen > rank) {
+            uint64_t v = hist_bucket_low(b);
+            return v < h->max ? v : h->max;
+        }
+    }
+    return h->max;
+}
+
+#endif /* _HISTOGRAM_H_ */
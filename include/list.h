@@ -4,9 +4,18 @@
 #define _LIST_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "lock.h"
 
-typedef intptr_t val_t;
+/* keys are 64-bit on every platform; VAL_MIN and VAL_MAX are reserved for
+ * the sentinel nodes, any other value can be stored. The hash set
+ * (LIST_HASH) only holds the keys within [0, 2^62): its functions return
+ * false for the others.
+ */
+typedef int64_t val_t;
+
+#define VAL_MIN INT64_MIN
+#define VAL_MAX INT64_MAX
 
 typedef struct node node_t;
 typedef struct list list_t;
@@ -30,4 +39,192 @@ bool list_remove(list_t *the_list, val_t val);
 void list_delete(list_t *the_list);
 int list_size(list_t *the_list);
 
+#if defined(LIST_APPROX)
+/* number of values of the list, provided by the variants built with
+ * LIST_APPROX, which count them in a striped counter (include/counter.h).
+ * Much cheaper than list_size, which takes a linearizable count, and exact
+ * while no update is under way; meanwhile, it may be off by the updates in
+ * flight.
+ */
+int list_size_approx(list_t *the_list);
+#endif
+
+#if defined(LIST_MAP)
+/* ordered map operations, provided by the variants built with LIST_MAP.
+ * Every node stores a payload inline next to its key, so a lookup costs no
+ * more cache misses than list_contains; the set operations above store a
+ * payload of 0.
+ */
+typedef uint64_t payload_t;
+
+/* look up the payload of key.
+ * @return true if found, with the payload stored in *payload
+ */
+bool list_get(list_t *the_list, val_t key, payload_t *payload);
+
+/* map key to payload, replacing the payload of key if it is present; the
+ * replaced payload is stored in *old, unless old is NULL.
+ * @return true if key was inserted, false if its payload was replaced
+ */
+bool list_put(list_t *the_list, val_t key, payload_t payload, payload_t *old);
+
+/* map key to payload only if key is absent; otherwise its payload is stored
+ * in *current, unless current is NULL.
+ * @return true if key was inserted
+ */
+bool list_put_if_absent(list_t *the_list,
+                        val_t key,
+                        payload_t payload,
+                        payload_t *current);
+
+/* atomically replace the payload of key with payload, if it is expected.
+ * @return true if replaced
+ */
+bool list_replace(list_t *the_list,
+                  val_t key,
+                  payload_t expected,
+                  payload_t payload);
+#endif
+
+#if defined(LIST_ACCEL)
+/* read accelerator (include/accel.h), provided by the variants built with
+ * LIST_ACCEL: list_contains answers from a sorted copy of the keys while no
+ * update happened since it was taken, and a thread rebuilds the copy once
+ * threshold of its lookups found it out of date. 0 disables it. Must be
+ * called before the list is shared.
+ */
+void list_accel(list_t *the_list, uint32_t threshold);
+
+/* number of copies of the keys published so far */
+uint64_t list_accel_rebuilds(list_t *the_list);
+#endif
+
+#if defined(LIST_SHM)
+#include <stddef.h>
+
+/* shared lists, provided by the variants built with LIST_SHM. The list lives
+ * in a region of shared memory, which processes may map at any address:
+ * threads of several processes can operate on it at the same time. The
+ * region of list_new is anonymous, and thus shared with the processes forked
+ * afterwards only; list_delete unmaps the region from the calling process.
+ */
+
+/* create a list in a new POSIX shared memory object of size bytes, named as
+ * for shm_open(3), or in an anonymous shared mapping if name is NULL. The
+ * object outlives the processes until it is removed with shm_unlink(3).
+ * @return the new list, or NULL with a message on stderr
+ */
+list_t *list_shm_create(const char *name, size_t size);
+
+/* map the list of the shared memory object name into the calling process.
+ * @return the list, or NULL with a message on stderr
+ */
+list_t *list_shm_attach(const char *name);
+#endif
+
+#if defined(LIST_BULK)
+#include <stddef.h>
+
+/* bulk operations, provided by the variants built with LIST_BULK. */
+
+/* build a list holding the n keys of keys, which must be in strictly
+ * ascending order and leave out VAL_MIN and VAL_MAX, in a single pass. The
+ * calling thread allocates the nodes one after the other, so the list is
+ * laid out in memory in the order it is traversed.
+ * @return the new list, or NULL if the keys are not sorted or not valid
+ */
+list_t *list_build_from_sorted(const val_t *keys, size_t n);
+
+/* save the keys of the list, with their payloads, to a dump file
+ * (include/dump.h); no other thread may update the list meanwhile.
+ * @return 0 on success, -1 with a message on stderr
+ */
+int list_save(list_t *the_list, const char *path);
+
+/* build a list from a dump file written by list_save.
+ * @return the new list, or NULL with a message on stderr
+ */
+list_t *list_load(const char *path);
+
+/* remove every value of the list. Other threads may keep using the list
+ * meanwhile: the values they add concurrently may or may not be removed.
+ * @return the number of values removed
+ */
+int list_clear(list_t *the_list);
+#endif
+
+#if defined(LIST_MULTI)
+/* interleaved lookups, provided by the variants built with LIST_MULTI.
+ * store in found[i] whether vals[i] is in the list, for the n values of
+ * vals, in any order. The searches are advanced together, one node each in
+ * turn, so their cache misses overlap instead of following each other; n
+ * is best set to about the number of misses a core can have in flight.
+ * @return the number of values found
+ */
+int list_contains_multi(list_t *the_list,
+                        const val_t *vals,
+                        int n,
+                        bool *found);
+#endif
+
+#if defined(LIST_BATCH)
+/* batched operations, provided by the variants built with LIST_BATCH.
+ * vals holds n values in ascending order, which are handled in a single
+ * traversal of the list; each value is added, removed or looked up as by
+ * the corresponding single-value operation.
+ * @return the number of values added, removed or found
+ */
+int list_add_batch(list_t *the_list, const val_t *vals, int n);
+int list_remove_batch(list_t *the_list, const val_t *vals, int n);
+int list_contains_batch(list_t *the_list, const val_t *vals, int n);
+#endif
+
+#if defined(LIST_RANGE)
+#include <stdlib.h>
+
+/* range queries, provided by the variants built with LIST_RANGE.
+ * store in buf, in ascending order, the first max values of the list within
+ * [lo, hi]; all the values are taken from the list at the same point in time.
+ * @return the number of values in the range, which may exceed max
+ */
+int list_range(list_t *the_list, val_t lo, val_t hi, val_t *buf, int max);
+
+/* iterator over a snapshot of the values within [lo, hi] */
+typedef struct list_iter {
+    val_t *vals;
+    int size, pos;
+} list_iter_t;
+
+static inline void list_iter_init(list_iter_t *it,
+                                  list_t *the_list,
+                                  val_t lo,
+                                  val_t hi)
+{
+    int max = 64;
+    it->vals = NULL;
+    while (1) {
+        it->vals = realloc(it->vals, max * sizeof(val_t));
+        it->size = list_range(the_list, lo, hi, it->vals, max);
+        if (it->size <= max)
+            break;
+        max = 2 * it->size; /* the range grew, take a new snapshot */
+    }
+    it->pos = 0;
+}
+
+/* @return false once all the values have been returned */
+static inline bool list_iter_next(list_iter_t *it, val_t *val)
+{
+    if (it->pos == it->size)
+        return false;
+    *val = it->vals[it->pos++];
+    return true;
+}
+
+static inline void list_iter_destroy(list_iter_t *it)
+{
+    free(it->vals);
+}
+#endif
+
 #endif
@@ -2,19 +2,117 @@
 #define _LOCK_IF_H_
 
 #include "atomics.h"
+#include "stats.h"
 #include "utils.h"
 
-typedef uint32_t ptlock_t;
-
 #if defined(LOCK_BASED)
+/* The lock implementation is selected at build time by defining LOCK_TYPE to
+ * one of the following values (default: LOCK_TAS).
+ */
+#define LOCK_TAS 0    /* test-and-set */
+#define LOCK_TTAS 1   /* test-and-test-and-set with exponential backoff */
+#define LOCK_TICKET 2 /* ticket lock with proportional backoff */
+#define LOCK_MCS 3    /* MCS queue lock (Mellor-Crummey and Scott, 1991) */
+#define LOCK_CLH 4    /* CLH queue lock (Craig; Landin and Hagersten) */
+#define LOCK_FUTEX 5  /* spin, then park the thread in the kernel */
+
+#if !defined(LOCK_TYPE)
+#define LOCK_TYPE LOCK_TAS
+#endif
+
 #define INIT_LOCK(lock) lock_init(lock)
 #define DESTROY_LOCK(lock) lock_destroy(lock)
 #define LOCK(lock) lock_lock(lock)
 #define UNLOCK(lock) lock_unlock(lock)
 
+/* upper bound of the backoff, in cpu_relax iterations */
+#define LOCK_MAX_BACKOFF 1024
+
+#if LOCK_TYPE == LOCK_TAS || LOCK_TYPE == LOCK_TTAS || LOCK_TYPE == LOCK_FUTEX
+typedef uint32_t ptlock_t;
+
+#elif LOCK_TYPE == LOCK_TICKET
+typedef struct {
+    uint32_t next;  /* next ticket to hand out */
+    uint32_t owner; /* ticket being served */
+} ptlock_t;
+
+#elif LOCK_TYPE == LOCK_MCS || LOCK_TYPE == LOCK_CLH
+/* A queue node, one per thread waiting for or holding a lock. A thread may
+ * hold several locks at once (hand-over-hand locking, list_size), so queue
+ * nodes come from a per-thread pool instead of being passed by the caller,
+ * and the holder records the node it used in the lock.
+ */
+typedef struct qnode {
+    struct qnode *volatile next; /* MCS: successor in the queue */
+    volatile uint32_t locked;
+    struct qnode *pool; /* next free node in the pool of its thread */
+} ALIGNED(64) qnode_t;
+
+typedef struct {
+    qnode_t *tail;   /* last node in the queue, NULL if free */
+    qnode_t *holder; /* node of the thread holding the lock */
+} ptlock_t;
+
+static __thread qnode_t *qnode_pool;
+
+static inline qnode_t *qnode_get(void)
+{
+    qnode_t *n = qnode_pool;
+    if (__builtin_expect(!n, 0)) {
+        if (posix_memalign((void **) &n, 64, sizeof(qnode_t)) != 0)
+            abort();
+    } else {
+        qnode_pool = n->pool;
+    }
+    return n;
+}
+
+static inline void qnode_put(qnode_t *n)
+{
+    n->pool = qnode_pool;
+    qnode_pool = n;
+}
+#endif
+
+#if LOCK_TYPE == LOCK_FUTEX
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <sched.h>
+#endif
+
+/* number of attempts before the thread goes to sleep */
+#define LOCK_SPIN_TRIES 128
+
+static inline void futex_wait(volatile ptlock_t *l, uint32_t val)
+{
+#if defined(__linux__)
+    syscall(SYS_futex, l, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+#else
+    sched_yield();
+#endif
+}
+
+static inline void futex_wake(volatile ptlock_t *l)
+{
+#if defined(__linux__)
+    syscall(SYS_futex, l, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#endif
+}
+#endif
+
 static inline void lock_init(volatile ptlock_t *l)
 {
+#if LOCK_TYPE == LOCK_TICKET
+    l->next = l->owner = 0;
+#elif LOCK_TYPE == LOCK_MCS || LOCK_TYPE == LOCK_CLH
+    l->tail = l->holder = NULL;
+#else
     *l = (uint32_t) 0;
+#endif
 }
 
 static inline void lock_destroy(volatile ptlock_t *l)
@@ -24,14 +122,131 @@ static inline void lock_destroy(volatile ptlock_t *l)
 
 static inline uint32_t lock_lock(volatile ptlock_t *l)
 {
+    STAT_INC(lock_acquires);
+#if LOCK_TYPE == LOCK_TAS
     while (CAS_U32(l, (uint32_t) 0, (uint32_t) 1) == 1)
-        ;
+        STAT_INC(lock_spins);
+
+#elif LOCK_TYPE == LOCK_TTAS
+    uint32_t backoff = 1;
+    while (1) {
+        /* spin on our cached copy until the lock looks free */
+        while (__atomic_load_n(l, __ATOMIC_RELAXED)) {
+            STAT_INC(lock_spins);
+            cpu_relax();
+        }
+        if (CAS_U32(l, (uint32_t) 0, (uint32_t) 1) == 0)
+            break;
+        STAT_ADD(lock_spins, backoff);
+        for (uint32_t i = 0; i < backoff; i++)
+            cpu_relax();
+        if (backoff < LOCK_MAX_BACKOFF)
+            backoff <<= 1;
+    }
+
+#elif LOCK_TYPE == LOCK_TICKET
+    uint32_t ticket = __atomic_fetch_add(&l->next, 1, __ATOMIC_RELAXED);
+    while (1) {
+        uint32_t owner = __atomic_load_n(&l->owner, __ATOMIC_ACQUIRE);
+        if (owner == ticket)
+            break;
+        /* back off in proportion to our position in the queue */
+        uint32_t backoff = (ticket - owner) * 32;
+        if (backoff > LOCK_MAX_BACKOFF)
+            backoff = LOCK_MAX_BACKOFF;
+        STAT_ADD(lock_spins, backoff);
+        for (uint32_t i = 0; i < backoff; i++)
+            cpu_relax();
+    }
+
+#elif LOCK_TYPE == LOCK_MCS
+    qnode_t *me = qnode_get();
+    me->next = NULL;
+    me->locked = 1;
+    qnode_t *pred = SWAP_PTR(&l->tail, me);
+    if (pred) {
+        __atomic_store_n(&pred->next, me, __ATOMIC_RELEASE);
+        while (__atomic_load_n(&me->locked, __ATOMIC_ACQUIRE)) {
+            STAT_INC(lock_spins);
+            cpu_relax();
+        }
+    }
+    l->holder = me;
+
+#elif LOCK_TYPE == LOCK_CLH
+    /* a free lock has no tail, so it does not own a dummy node that would
+     * have to outlive it; the holder of a freed lock keeps its own node.
+     */
+    qnode_t *me = qnode_get();
+    me->locked = 1;
+    qnode_t *pred = SWAP_PTR(&l->tail, me);
+    if (pred) {
+        while (__atomic_load_n(&pred->locked, __ATOMIC_ACQUIRE)) {
+            STAT_INC(lock_spins);
+            cpu_relax();
+        }
+        qnode_put(pred); /* nobody else references it any more */
+    }
+    l->holder = me;
+
+#elif LOCK_TYPE == LOCK_FUTEX
+    /* 0: free, 1: locked, 2: locked and somebody may be sleeping */
+    for (int i = 0; i < LOCK_SPIN_TRIES; i++) {
+        if (!__atomic_load_n(l, __ATOMIC_RELAXED) &&
+            CAS_U32(l, (uint32_t) 0, (uint32_t) 1) == 0)
+            return 0;
+        STAT_INC(lock_spins);
+        cpu_relax();
+    }
+    uint32_t c = CAS_U32(l, (uint32_t) 0, (uint32_t) 1);
+    if (c != 0) {
+        if (c != 2)
+            c = SWAP_U32(l, (uint32_t) 2);
+        while (c != 0) {
+            STAT_INC(lock_spins);
+            futex_wait(l, 2);
+            c = SWAP_U32(l, (uint32_t) 2);
+        }
+    }
+#endif
     return 0;
 }
 
 static inline uint32_t lock_unlock(volatile ptlock_t *l)
 {
-    *l = (uint32_t) 0;
+#if LOCK_TYPE == LOCK_TAS || LOCK_TYPE == LOCK_TTAS
+    __atomic_store_n(l, (uint32_t) 0, __ATOMIC_RELEASE);
+
+#elif LOCK_TYPE == LOCK_TICKET
+    __atomic_store_n(&l->owner, l->owner + 1, __ATOMIC_RELEASE);
+
+#elif LOCK_TYPE == LOCK_MCS
+    qnode_t *me = l->holder;
+    if (!me->next) {
+        if (CAS_PTR((qnode_t **) &l->tail, me, NULL) == me) {
+            qnode_put(me);
+            return 0;
+        }
+        /* a successor swapped the tail, wait until it links itself */
+        while (!__atomic_load_n(&me->next, __ATOMIC_ACQUIRE))
+            cpu_relax();
+    }
+    __atomic_store_n(&me->next->locked, 0, __ATOMIC_RELEASE);
+    qnode_put(me);
+
+#elif LOCK_TYPE == LOCK_CLH
+    qnode_t *me = l->holder;
+    if (CAS_PTR((qnode_t **) &l->tail, me, NULL) == me)
+        qnode_put(me);
+    else /* the successor spins on our node and takes it over */
+        __atomic_store_n(&me->locked, 0, __ATOMIC_RELEASE);
+
+#elif LOCK_TYPE == LOCK_FUTEX
+    if (__atomic_fetch_sub(l, 1, __ATOMIC_RELEASE) != 1) {
+        __atomic_store_n(l, (uint32_t) 0, __ATOMIC_RELEASE);
+        futex_wake(l);
+    }
+#endif
     return 0;
 }
 
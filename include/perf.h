@@ -0,0 +1,46 @@
+/* Per-thread performance counters, through perf_event_open(2).
+ *
+ * The events to count are chosen once by name (the names of perf(1), e.g.
+ * cycles or LLC-load-misses). Every thread then opens its own counters,
+ * disabled, and they are enabled and disabled around the measured phase
+ * only, so that the prefill of the list is not counted. Counters that the
+ * kernel multiplexes are scaled by the share of the time they ran.
+ * Hardware events are only counted in user space. Only available on Linux.
+ */
+#ifndef _PERF_H_
+#define _PERF_H_
+
+#include <stdint.h>
+
+#define PERF_MAX_EVENTS 8
+
+#define PERF_DEFAULT_EVENTS "cycles,instructions,cache-misses,LLC-load-misses"
+
+typedef struct perf_counters {
+    int fds[PERF_MAX_EVENTS];
+    int n;
+} perf_counters_t;
+
+/* select the comma-separated events of list.
+ * @return the number of events, or -1 with a message on stderr
+ */
+int perf_select(const char *list);
+
+/* number and names of the selected events */
+int perf_events(void);
+const char *perf_event_name(int i);
+
+/* open the selected counters for the calling thread, disabled.
+ * @return 0 on success, -1 with a message on stderr
+ */
+int perf_open(perf_counters_t *c);
+
+void perf_enable(perf_counters_t *c);
+void perf_disable(perf_counters_t *c);
+
+/* add the scaled values of the counters to values, one per event */
+void perf_read(perf_counters_t *c, uint64_t *values);
+
+void perf_close(perf_counters_t *c);
+
+#endif /* _PERF_H_ */
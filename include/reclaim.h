@@ -0,0 +1,204 @@
+/* Safe memory reclamation for lists whose readers do not take locks.
+ *
+ * A node that has been unlinked from the list may still be referenced by
+ * concurrent readers, so it is handed to reclaim_retire() instead of being
+ * freed, and the scheme decides when the memory can actually be released
+ * with node_free().
+ * The scheme is selected at build time by defining RECLAIM to one of the
+ * values below.
+ */
+#ifndef _RECLAIM_H_
+#define _RECLAIM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "atomics.h"
+#include "utils.h"
+
+#define RECLAIM_LEAK 0 /* never free; retired nodes are only counted */
+#define RECLAIM_HP 1   /* hazard pointers (Michael, 2004) */
+#define RECLAIM_EBR 2  /* epoch-based reclamation (Fraser, 2004) */
+
+#if !defined(RECLAIM)
+#error "RECLAIM must be set to RECLAIM_LEAK, RECLAIM_HP or RECLAIM_EBR"
+#endif
+
+/* number of hazard pointers a thread can hold at the same time */
+#define RECLAIM_SLOTS 4
+
+/* a vector of retired nodes waiting to be freed */
+typedef struct retire_bag {
+    void **nodes;
+    uint32_t count, capacity;
+    uint64_t epoch; /* EBR: epoch in which the nodes were retired */
+} retire_bag_t;
+
+/* per-thread reclamation state, linked in a global registry so that the
+ * reclaiming thread can look at the hazard pointers (or epochs) of all the
+ * others.
+ */
+typedef struct reclaim_thread {
+    void *volatile hazard[RECLAIM_SLOTS]; /* HP: protected nodes */
+    volatile uint64_t epoch; /* EBR: (epoch << 1) | 1 when active, else 0 */
+    retire_bag_t bags[3];    /* HP uses bags[0]; EBR one bag per epoch */
+    uint64_t retired;        /* nodes passed to reclaim_retire */
+    uint64_t freed;          /* nodes actually freed */
+    uint64_t peak;           /* highest number of pending nodes */
+    struct reclaim_thread *next;
+} ALIGNED(64) reclaim_thread_t;
+
+typedef struct reclaim_stats {
+    uint64_t retired; /* nodes retired by all threads */
+    uint64_t freed;   /* nodes freed by all threads */
+    uint64_t pending; /* nodes still waiting to be freed */
+    uint64_t peak;    /* sum of the per-thread peaks of pending nodes */
+} reclaim_stats_t;
+
+extern __thread reclaim_thread_t *reclaim_self;
+extern uint64_t reclaim_epoch;
+
+reclaim_thread_t *reclaim_register(void);
+void reclaim_collect(reclaim_thread_t *self);
+void reclaim_stats(reclaim_stats_t *stats);
+
+static inline reclaim_thread_t *reclaim_thread(void)
+{
+    reclaim_thread_t *self = reclaim_self;
+    if (__builtin_expect(!self, 0))
+        self = reclaim_register();
+    return self;
+}
+
+/* reclaim_enter/reclaim_exit bracket every list operation: no node retired
+ * after reclaim_enter can be freed before the matching reclaim_exit, as long
+ * as the node was obtained through reclaim_protect.
+ */
+static inline void reclaim_enter(void)
+{
+#if RECLAIM == RECLAIM_HP
+    reclaim_thread();
+#elif RECLAIM == RECLAIM_EBR
+    reclaim_thread_t *self = reclaim_thread();
+    uint64_t e = __atomic_load_n(&reclaim_epoch, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&self->epoch, (e << 1) | 1, __ATOMIC_SEQ_CST);
+    /* the epoch moved on since we last retired something; release what
+     * became safe in the meantime.
+     */
+    retire_bag_t *oldest = &self->bags[(e + 1) % 3];
+    if (oldest->count && oldest->epoch + 2 <= e)
+        reclaim_collect(self);
+#endif
+}
+
+static inline void reclaim_exit(void)
+{
+#if RECLAIM == RECLAIM_HP
+    reclaim_thread_t *self = reclaim_self;
+    for (int i = 0; i < RECLAIM_SLOTS; i++)
+        __atomic_store_n(&self->hazard[i], NULL, __ATOMIC_RELEASE);
+#elif RECLAIM == RECLAIM_EBR
+    __atomic_store_n(&reclaim_self->epoch, 0, __ATOMIC_RELEASE);
+#endif
+}
+
+/* read the pointer stored at addr and make sure the node it points to
+ * (ignoring the low-order mark bit) will not be freed until the slot is
+ * reused or reclaim_exit is called.
+ */
+static inline void *reclaim_protect(int slot, void *volatile *addr)
+{
+#if RECLAIM == RECLAIM_HP
+    reclaim_thread_t *self = reclaim_self;
+    void *p = *addr;
+    while (1) {
+        __atomic_store_n(&self->hazard[slot],
+                         (void *) ((uintptr_t) p & ~(uintptr_t) 0x1),
+                         __ATOMIC_SEQ_CST);
+        void *q = __atomic_load_n(addr, __ATOMIC_SEQ_CST);
+        if (q == p)
+            return p;
+        p = q;
+    }
+#else
+    (void) slot;
+    return *addr;
+#endif
+}
+
+/* A node that a thread saw unmarked during an operation is not freed before
+ * the end of any later operation of the thread with the same token, so it can
+ * be used to start a search. Hazard pointers give no such guarantee (0).
+ */
+static inline uint64_t reclaim_token(void)
+{
+#if RECLAIM == RECLAIM_LEAK
+    return 1;
+#elif RECLAIM == RECLAIM_EBR
+    /* it is retired in this epoch or later, and freed two epochs after */
+    return reclaim_self->epoch;
+#else
+    return 0;
+#endif
+}
+
+/* protect a node already protected through another slot, so that the other
+ * slot can be reused.
+ */
+static inline void reclaim_hold(int slot, void *node)
+{
+#if RECLAIM == RECLAIM_HP
+    __atomic_store_n(&reclaim_self->hazard[slot], node, __ATOMIC_SEQ_CST);
+#else
+    (void) slot;
+    (void) node;
+#endif
+}
+
+/* hand an unlinked node over to the reclamation scheme */
+static inline void reclaim_retire(void *node)
+{
+    reclaim_thread_t *self = reclaim_thread();
+#if RECLAIM == RECLAIM_LEAK
+    (void) node; /* keep the node: nothing tells us when it is safe */
+    self->retired++;
+    self->peak = self->retired;
+#else
+#if RECLAIM == RECLAIM_HP
+    retire_bag_t *bag = &self->bags[0];
+#else
+    /* label the node with the global epoch observed after it was unlinked;
+     * any thread that may still hold it is active in that epoch or before.
+     */
+    uint64_t e = __atomic_load_n(&reclaim_epoch, __ATOMIC_SEQ_CST);
+    retire_bag_t *bag = &self->bags[e % 3];
+    if (bag->epoch != e) { /* the bag holds nodes from epoch e - 3 or older */
+        reclaim_collect(self);
+        bag->epoch = e;
+    }
+#endif
+    if (bag->count == bag->capacity) {
+        bag->capacity = bag->capacity ? 2 * bag->capacity : 64;
+        bag->nodes = realloc(bag->nodes, bag->capacity * sizeof(void *));
+    }
+    bag->nodes[bag->count++] = node;
+    self->retired++;
+    uint64_t pending = self->retired - self->freed;
+    if (pending > self->peak)
+        self->peak = pending;
+    if ((self->retired & 0x3f) == 0) /* amortize the scan */
+        reclaim_collect(self);
+#endif
+}
+
+/* hand over a block obtained with malloc (or posix_memalign) instead of
+ * node_alloc, e.g. a whole array that readers may still be looking at; it is
+ * released with free(). The low bit of its address tells it from a node.
+ */
+static inline void reclaim_retire_block(void *block)
+{
+    reclaim_retire((void *) ((uintptr_t) block | 1));
+}
+
+#endif /* _RECLAIM_H_ */
@@ -0,0 +1,44 @@
+/* Registry of the list variants linked into a single binary (out/lists).
+ *
+ * Every variant is built from its own objects, with its own flags, and they
+ * all define the same symbols (list_new, node_alloc, main, ...). For the
+ * registry binary, the objects of a variant and its descriptor (src/impl.c)
+ * are linked into one relocatable object in which every symbol but the
+ * descriptor is made local: calls within a variant stay direct calls, and
+ * the variants cannot see each other.
+ *
+ * A descriptor holds the operations of the variant, for drivers that do not
+ * mind an indirect call per operation, and the benchmark driver of
+ * src/main.c compiled for the variant, whose worker loop calls the list
+ * directly. Descriptors are placed in the impl_table section, so that the
+ * registry finds every variant linked in without a list of their names.
+ */
+#ifndef _REGISTRY_H_
+#define _REGISTRY_H_
+
+#include <stdbool.h>
+
+#include "list.h"
+
+typedef struct list_ops {
+    list_t *(*new)(void);
+    void (*delete)(list_t *the_list);
+    bool (*contains)(list_t *the_list, val_t val);
+    bool (*add)(list_t *the_list, val_t val);
+    bool (*remove)(list_t *the_list, val_t val);
+    int (*size)(list_t *the_list);
+} list_ops_t;
+
+typedef struct impl {
+    const char *name; /* the name of the variant, as in out/test-<name> */
+    list_ops_t ops;
+    /* main of the benchmark driver; may only be run once per process */
+    int (*run)(int argc, char *const argv[]);
+} impl_t;
+
+#define IMPL_SECTION __attribute__((section("impl_table"), used))
+
+/* bounds of the impl_table section, set by the linker */
+extern const impl_t __start_impl_table[], __stop_impl_table[];
+
+#endif /* _REGISTRY_H_ */
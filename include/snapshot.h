@@ -0,0 +1,80 @@
+/* Timestamps for linearizable range queries on lock-free lists.
+ *
+ * A range query takes a snapshot time ts from a global clock, which only
+ * range queries advance, so that point operations never write to it. Every
+ * node records when it was inserted and when it was removed, and belongs to
+ * the snapshot iff ins_ts <= ts < del_ts. Timestamps are set right after the
+ * linking CAS and the marking CAS, and any thread that observes a node whose
+ * timestamp is still missing sets it first, so that the order of the
+ * timestamps matches what every thread saw.
+ *
+ * A node removed after ts may be unlinked before the range query reaches it.
+ * To cover that case, whoever unlinks a node first reports it to the running
+ * range queries that may need it, which merge the reports into their result.
+ */
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "atomics.h"
+#include "list.h"
+#include "utils.h"
+
+#define SNAP_IDLE UINT64_MAX /* announced by threads not in a range query */
+
+/* a removed node, as seen by the thread that unlinked it */
+typedef struct snap_report {
+    val_t key;
+    uint64_t ins_ts, del_ts;
+    struct snap_report *next;
+} snap_report_t;
+
+/* per-thread range query state, linked in a global registry */
+typedef struct snap_thread {
+    uint64_t ts;            /* lower bound of the current snapshot time */
+    snap_report_t *reports; /* nodes unlinked during the range query */
+    struct snap_thread *next;
+} ALIGNED(64) snap_thread_t;
+
+extern uint64_t snap_clock;  /* starts at 1, 0 means "not set yet" */
+extern uint32_t snap_active; /* number of range queries running */
+
+/* return the timestamp stored at ts, setting it to the current time first if
+ * nobody did.
+ */
+static inline uint64_t snap_stamp(uint64_t *ts)
+{
+    uint64_t t = __atomic_load_n(ts, __ATOMIC_ACQUIRE);
+    if (__builtin_expect(!t, 0)) {
+        uint64_t now = __atomic_load_n(&snap_clock, __ATOMIC_SEQ_CST);
+        t = CAS_U64(ts, 0, now);
+        if (!t)
+            t = now;
+    }
+    return t;
+}
+
+/* true if some range query may need the nodes being unlinked */
+static inline bool snap_reporting(void)
+{
+    return __builtin_expect(__atomic_load_n(&snap_active, __ATOMIC_SEQ_CST), 0);
+}
+
+/* to be called before unlinking a removed node whose del_ts is set, if
+ * snap_reporting() returned true.
+ */
+void snap_report(val_t key, uint64_t ins_ts, uint64_t del_ts);
+
+/* start a range query and return its snapshot time */
+uint64_t snap_begin(void);
+
+/* end the range query started at ts: add the reported keys within [lo, hi]
+ * that belong to the snapshot to the n sorted keys collected from the list,
+ * of which at most max are stored in buf.
+ * @return the number of keys in the range
+ */
+int snap_end(uint64_t ts, val_t lo, val_t hi, val_t *buf, int n, int max);
+
+#endif /* _SNAPSHOT_H_ */
@@ -0,0 +1,52 @@
+/* Contention statistics of the list internals.
+ *
+ * They are only compiled in with -DSTATS (make STATS=1): every thread then
+ * counts events in its own thread-local record, which the benchmark merges
+ * at the end of the run. In the default build, the counters compile to
+ * nothing.
+ */
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stdint.h>
+
+typedef struct stats {
+    uint64_t cas_failures;   /* failed CAS in list_add and list_remove */
+    uint64_t search_retries; /* restarts of the search loop */
+    uint64_t marked_skipped; /* logically deleted nodes stepped over */
+    uint64_t marked_snipped; /* logically deleted nodes unlinked */
+    uint64_t traversed;      /* nodes visited */
+    uint64_t lock_acquires;  /* calls to lock_lock */
+    uint64_t lock_spins;     /* iterations spent waiting for a lock */
+    uint64_t snap_hits;      /* lookups answered by the read accelerator */
+    uint64_t snap_stale;     /* lookups that found its copy out of date */
+} stats_t;
+
+static inline void stats_merge(stats_t *s, const stats_t *other)
+{
+    s->cas_failures += other->cas_failures;
+    s->search_retries += other->search_retries;
+    s->marked_skipped += other->marked_skipped;
+    s->marked_snipped += other->marked_snipped;
+    s->traversed += other->traversed;
+    s->lock_acquires += other->lock_acquires;
+    s->lock_spins += other->lock_spins;
+    s->snap_hits += other->snap_hits;
+    s->snap_stale += other->snap_stale;
+}
+
+#if defined(STATS)
+extern __thread stats_t stats_self;
+
+#define STAT_INC(field) (stats_self.field++)
+#define STAT_ADD(field, n) (stats_self.field += (n))
+#else
+#define STAT_INC(field) \
+    do {                \
+    } while (0)
+#define STAT_ADD(field, n) \
+    do {                   \
+    } while (0)
+#endif
+
+#endif /* _STATS_H_ */
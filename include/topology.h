@@ -0,0 +1,40 @@
+/* Processor topology and thread placement for the benchmark driver.
+ *
+ * The topology of the online cpus is read from sysfs. Without sysfs, the
+ * machine is assumed to have CORE_NUM cpus on a single socket, each cpu
+ * being a core of its own.
+ */
+#ifndef _TOPOLOGY_H_
+#define _TOPOLOGY_H_
+
+#define PIN_NONE 0    /* let the scheduler place the threads */
+#define PIN_COMPACT 1 /* fill SMT siblings, then cores, then sockets */
+#define PIN_SCATTER 2 /* round-robin over sockets, SMT siblings last */
+#define PIN_LIST 3    /* explicit list of cpus, e.g. 0-3,8,10 */
+
+typedef struct cpu_info {
+    int cpu;    /* logical cpu number */
+    int socket; /* physical package id */
+    int core;   /* core id, unique within its socket */
+    int smt;    /* rank of the cpu among the siblings of its core */
+    int node;   /* NUMA node, 0 if unknown */
+} cpu_info_t;
+
+/* read the topology of the online cpus into *cpus, sorted by cpu number.
+ * @return the number of cpus
+ */
+int topology_read(cpu_info_t **cpus);
+
+/* order the online cpus according to policy, or as given by the cpu list
+ * list for PIN_LIST, and store them in *order; thread i is meant to run on
+ * (*order)[i % n].
+ * @return the number of cpus n, or -1 if the list is invalid
+ */
+int topology_place(int policy, const char *list, cpu_info_t **order);
+
+/* pin the calling thread to cpu.
+ * @return 0 on success, -1 on failure
+ */
+int topology_pin(int cpu);
+
+#endif /* _TOPOLOGY_H_ */
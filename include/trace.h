@@ -0,0 +1,99 @@
+/* Operation traces: per-thread streams of (operation, key) records that the
+ * benchmark can record from its synthetic generator and replay later.
+ *
+ * A trace file holds a header, a table with one entry per stream, and the
+ * streams themselves. Each record is a 64-bit word holding the key shifted
+ * by two bits and the operation in the low two bits, so the replay reads the
+ * memory-mapped records directly; keys must thus be within [-2^61, 2^61). All fields are in the byte order of the
+ * recording machine.
+ */
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "list.h"
+
+#define TRACE_MAGIC "LLTRACE1"
+
+#define TRACE_CONTAINS 0
+#define TRACE_ADD 1
+#define TRACE_REMOVE 2
+#define TRACE_SCAN 3 /* range scan of scan_width keys from the key */
+
+typedef struct trace_header {
+    char magic[8];       /* TRACE_MAGIC, not terminated */
+    uint32_t streams;    /* number of streams, one per recording thread */
+    uint32_t scan_width; /* number of keys covered by a range scan */
+    uint64_t range;      /* key range of the recording run */
+} trace_header_t;
+
+typedef struct trace_stream {
+    uint64_t offset;  /* of the first record, in bytes from the file start */
+    uint64_t prefill; /* leading records that fill the list before the run */
+    uint64_t count;   /* number of records, including the prefill */
+} trace_stream_t;
+
+/* a memory-mapped trace file */
+typedef struct trace {
+    void *map;
+    size_t size;
+    const trace_header_t *header;
+    const trace_stream_t *streams;
+} trace_t;
+
+/* a stream being recorded */
+typedef struct trace_buf {
+    uint64_t *recs;
+    uint64_t prefill, count, capacity;
+} trace_buf_t;
+
+static inline uint64_t trace_pack(int op, val_t key)
+{
+    return (uint64_t) key << 2 | (uint64_t) op;
+}
+
+static inline int trace_op(uint64_t rec)
+{
+    return (int) (rec & 3);
+}
+
+static inline val_t trace_key(uint64_t rec)
+{
+    return (val_t) rec >> 2; /* keeps the sign */
+}
+
+static inline void trace_push(trace_buf_t *b, int op, val_t key)
+{
+    if (__builtin_expect(b->count == b->capacity, 0)) {
+        b->capacity = b->capacity ? 2 * b->capacity : 4096;
+        b->recs = realloc(b->recs, b->capacity * sizeof(uint64_t));
+        if (!b->recs)
+            abort();
+    }
+    b->recs[b->count++] = trace_pack(op, key);
+}
+
+static inline const uint64_t *trace_records(const trace_t *t, int stream)
+{
+    return (const uint64_t *) ((const char *) t->map +
+                               t->streams[stream].offset);
+}
+
+/* map and validate the trace file at path.
+ * @return 0 on success, -1 on failure, with a message on stderr
+ */
+int trace_open(trace_t *t, const char *path);
+
+void trace_close(trace_t *t);
+
+/* write the n streams of bufs to a trace file at path, with the header
+ * fields of h; the magic and the number of streams are filled in.
+ * @return 0 on success, -1 on failure, with a message on stderr
+ */
+int trace_write(const char *path, trace_header_t *h, const trace_buf_t *bufs,
+                int n);
+
+#endif /* _TRACE_H_ */
@@ -9,6 +9,21 @@
 #define ALIGNED(N) __attribute__((aligned(N)))
 #endif
 
+/* compile-time check; _Static_assert is C11, hence __extension__ */
+#define STATIC_ASSERT(cond, msg) __extension__ _Static_assert(cond, msg)
+
+/* Hint to the processor that we are in a spin-wait loop */
+static inline void cpu_relax(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__("pause" ::: "memory");
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield" ::: "memory");
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
 /* Round up to next higher power of 2 (return x if it's already a power
  * of 2) for 32-bit numbers
  */
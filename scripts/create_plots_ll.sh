@@ -1,6 +1,7 @@
 #!/usr/bin/env bash
 
-app_all="ll";
+app_all="ll unrolled locks skiplist";
+locks="tas ttas ticket mcs clh futex";
 
 dat_dir="out/data";
 gp_dir="out/gp";
@@ -14,7 +15,7 @@ gp_template="scripts/template.gp";
 rm -f $gp_dir/* >> /dev/null;
 rm -f $plot_dir/* >> /dev/null;
 
-initial_all="128 1024 8192";
+initial_all="128 1024 8192 65536 262144 1048576";
 update_all="0 10 50";
 
 for update in $update_all
@@ -33,6 +34,9 @@ do
 	    png="$plot_dir/$app.i$initial.u$update.png";
 	    title="Lock-free vs. Lock-based $app / Size: $initial / Update: $update";
 
+	    # not every application is run for every size
+	    [ -f "$dat" ] || continue;
+
 	    cp $gp_template $gp
 
 	    if [ "$app" = "ll" ];
@@ -45,6 +49,46 @@ plot \\
 "$dat" using 1:(\$4) axis x1y2 title  "lb - Scalability" ls 1 with points, \\
 "$dat" using 1:(\$5) title  "lf - Througput" ls 4 with lines, \\
 "$dat" using 1:(\$7) axis x1y2 title  "lf - Scalability" ls 3 with points
+EOF
+	    elif [ "$app" = "unrolled" ];
+	    then
+		cat << EOF >> $gp
+set title "Unrolled vs. Harris list / Size: $initial / Update: $update";
+set output "$png";
+plot \\
+"$dat" using 1:(\$2) title  "lf - Througput" ls 2 with lines, \\
+"$dat" using 1:(\$4) axis x1y2 title  "lf - Scalability" ls 1 with points, \\
+"$dat" using 1:(\$5) title  "unrolled - Througput" ls 4 with lines, \\
+"$dat" using 1:(\$7) axis x1y2 title  "unrolled - Scalability" ls 3 with points
+EOF
+	    elif [ "$app" = "skiplist" ];
+	    then
+		cat << EOF >> $gp
+set title "Lock-free skip list / Size: $initial / Update: $update";
+set output "$png";
+plot \\
+"$dat" using 1:(\$2) title  "Througput" ls 2 with lines, \\
+"$dat" using 1:(\$4) axis x1y2 title  "Scalability" ls 1 with points
+EOF
+	    elif [ "$app" = "locks" ];
+	    then
+		# three columns per lock: throughput, %linear, scalability
+		title="Lock implementations / Size: $initial / Update: $update";
+		plot="";
+		col=2;
+		ls=1;
+		for lock in $locks;
+		do
+		    [ -z "$plot" ] || plot="$plot, \\"$'\n';
+		    plot="$plot\"$dat\" using 1:(\$$col) title \"$lock\" ls $ls with lines";
+		    col=$((col+3));
+		    ls=$((ls+1));
+		done;
+		cat << EOF >> $gp
+set title "$title";
+set output "$png";
+plot \\
+$plot
 EOF
 	    fi;
 
@@ -10,6 +10,13 @@ duration="2000";
 
 initials="128 1024 8192";
 updates="0 10 50";
+locks="tas ttas ticket mcs clh futex";
+
+lock_progs="";
+for lock in $locks;
+do
+    lock_progs="$lock_progs out/test-lock-$lock";
+done;
 
 for initial in $initials; 
 do
@@ -25,5 +32,33 @@ do
         scripts/scalability2.sh "$cores" \
             out/test-lock out/test-lockfree \
             -d$duration -i$initial -r$range -u$update | tee $out;
+
+        out="$out_dir/unrolled.i$initial.u$update.dat";
+        scripts/scalability2.sh "$cores" \
+            out/test-lockfree out/test-unrolled \
+            -d$duration -i$initial -r$range -u$update | tee $out;
+
+        out="$out_dir/locks.i$initial.u$update.dat";
+        scripts/scalabilityN.sh "$cores" $lock_progs \
+            -d$duration -i$initial -r$range -u$update | tee $out;
+    done
+done
+
+# the skip list is meant for sizes where O(n) lists are out of the question
+large_initials="65536 262144 1048576";
+
+for initial in $large_initials;
+do
+    echo "* -i$initial";
+
+    range=$((2*$initial));
+
+    for update in $updates;
+    do
+	echo "** -u$update";
+
+        out="$out_dir/skiplist.i$initial.u$update.dat";
+        scripts/scalability1.sh "$cores" out/test-skiplist \
+            -d$duration -i$initial -r$range -u$update | tee $out;
     done
 done
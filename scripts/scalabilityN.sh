@@ -0,0 +1,64 @@
+#!/usr/bin/env bash
+
+cores=$1;
+shift;
+
+source scripts/lock_exec;
+source scripts/config;
+
+# the programs to compare come first, followed by the parameters passed to
+# all of them (which start with a dash)
+progs="";
+while [ $# -gt 0 ] && [ "${1:0:1}" != "-" ];
+do
+    progs="$progs $1";
+    shift;
+done;
+params="$@";
+
+printf "#       ";
+for prog in $progs;
+do
+    printf "%-32s" "$prog";
+done;
+printf "\n#cores  ";
+for prog in $progs;
+do
+    printf "throughput  %%linear scalability ";
+done;
+printf "\n";
+
+declare -A thr1;
+
+printf "%-8d" 1;
+for prog in $progs;
+do
+    thr1[$prog]=$(./$prog $params -n1 | grep "#txs" | cut -d'(' -f2 | cut -d. -f1);
+    printf "%-12d" ${thr1[$prog]};
+    printf "%-8.2f" 100.00;
+    printf "%-12d" 1;
+done;
+printf "\n";
+
+for c in $cores
+do
+    if [ $c -eq 1 ]
+    then
+	continue;
+    fi;
+
+    printf "%-8d" $c;
+
+    for prog in $progs;
+    do
+	thr=$(./$prog $params -n$c | grep "#txs" | cut -d'(' -f2 | cut -d. -f1);
+	printf "%-12d" $thr;
+	scl=$(echo "$thr/${thr1[$prog]}" | bc -l);
+	linear_p=$(echo "100*(1-(($c-$scl)/$c))" | bc -l);
+	printf "%-8.2f" $linear_p;
+	printf "%-12.2f" $scl;
+    done;
+    printf "\n";
+done;
+
+source scripts/unlock_exec;
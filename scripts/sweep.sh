@@ -0,0 +1,154 @@
+#!/usr/bin/env bash
+
+# Benchmark several applications over thread counts, initial sizes and
+# update rates, repeating every point, and summarize the throughput of each
+# point with its mean, standard deviation and 95% confidence interval.
+#
+# usage: scripts/sweep.sh [options] prog... [-- params passed to every run]
+#   -t <threads>  thread counts (default: 1 up to the number of cores)
+#   -i <sizes>    initial sizes, the key range being twice as large
+#                 (default: "1024")
+#   -u <updates>  update percentages (default: "0 10 50")
+#   -r <runs>     measured runs per point (default: 5)
+#   -w <runs>     warm-up runs per point, discarded (default: 1)
+#   -d <ms>       duration of every run (default: 1000)
+#   -o <dir>      output directory (default: out/sweep)
+#
+# The results go to <dir>/samples.csv (one line per measured run) and
+# <dir>/summary.csv (one line per point), and, if gnuplot is installed,
+# <dir>/plots/i<size>.u<update>.png compares the applications.
+
+threads="";
+initials="1024";
+updates="0 10 50";
+runs=5;
+warmups=1;
+duration=1000;
+out_dir="out/sweep";
+
+while getopts "t:i:u:r:w:d:o:" opt;
+do
+    case $opt in
+	t) threads="$OPTARG";;
+	i) initials="$OPTARG";;
+	u) updates="$OPTARG";;
+	r) runs="$OPTARG";;
+	w) warmups="$OPTARG";;
+	d) duration="$OPTARG";;
+	o) out_dir="$OPTARG";;
+	*) exit 1;;
+    esac;
+done;
+shift $((OPTIND-1));
+
+progs="";
+while [ $# -gt 0 ] && [ "$1" != "--" ];
+do
+    progs="$progs $1";
+    shift;
+done;
+[ "$1" = "--" ] && shift;
+params="$@";
+
+if [ -z "$progs" ];
+then
+    echo "usage: $0 [options] prog... [-- params]";
+    exit 1;
+fi;
+
+source scripts/lock_exec;
+source scripts/config;
+
+[ -n "$threads" ] || threads=$(seq 1 1 $num_cores);
+
+mkdir -p $out_dir/data $out_dir/plots;
+samples="$out_dir/samples.csv";
+summary="$out_dir/summary.csv";
+echo "list,initial,update_pct,threads,run,throughput" > $samples;
+echo "list,initial,update_pct,threads,runs,mean,stddev,ci95" > $summary;
+
+# throughput of the run, from the csv output of the benchmark
+throughput() {
+    "$@" -o csv | awk -F, '
+	NR == 1 { for (i = 1; i <= NF; i++) col[$i] = i; next }
+	$col["thread"] == "all" { print $col["throughput"] }';
+}
+
+# mean, standard deviation and half-width of the 95% confidence interval
+# (Student t) of the samples, one per line
+statistics() {
+    awk '
+	BEGIN {
+	    split("12.706 4.303 3.182 2.776 2.571 2.447 2.365 2.306 2.262 " \
+		  "2.228 2.201 2.179 2.160 2.145 2.131 2.120 2.110 2.101 " \
+		  "2.093 2.086 2.080 2.074 2.069 2.064 2.060 2.056 2.052 " \
+		  "2.048 2.045 2.042", t, " ");
+	}
+	{ x[n++] = $1; sum += $1 }
+	END {
+	    mean = sum / n;
+	    for (i = 0; i < n; i++)
+		ss += (x[i] - mean) ^ 2;
+	    sd = n > 1 ? sqrt(ss / (n - 1)) : 0;
+	    q = n - 1 > 30 ? 1.96 : (n > 1 ? t[n - 1] : 0);
+	    printf "%d,%.2f,%.2f,%.2f\n", n, mean, sd, q * sd / sqrt(n);
+	}';
+}
+
+for initial in $initials;
+do
+    range=$((2*$initial));
+    for update in $updates;
+    do
+	echo "* -i$initial -u$update";
+	for prog in $progs;
+	do
+	    name=$(basename $prog);
+	    name=${name#test-};
+	    dat="$out_dir/data/$name.i$initial.u$update.dat";
+	    echo "#threads mean stddev ci95" > $dat;
+	    for n in $threads;
+	    do
+		args="-n$n -d$duration -i$initial -r$range -u$update $params";
+		for w in $(seq 1 1 $warmups);
+		do
+		    throughput ./$prog $args > /dev/null;
+		done;
+		values="";
+		for r in $(seq 1 1 $runs);
+		do
+		    v=$(throughput ./$prog $args);
+		    echo "$name,$initial,$update,$n,$r,$v" >> $samples;
+		    values="$values$v"$'\n';
+		done;
+		stats=$(printf "%s" "$values" | statistics);
+		echo "$name,$initial,$update,$n,$stats" >> $summary;
+		echo "$n $stats" | tr ',' ' ' | awk '{print $1, $3, $4, $5}' >> $dat;
+		printf "  %-16s %3d threads: %s\n" $name $n "$stats";
+	    done;
+	done;
+
+	command -v gnuplot > /dev/null || continue;
+	gp="$out_dir/plots/i$initial.u$update.gp";
+	cp scripts/template.gp $gp;
+	plot="";
+	ls=1;
+	for prog in $progs;
+	do
+	    name=$(basename $prog);
+	    name=${name#test-};
+	    [ -z "$plot" ] || plot="$plot, \\"$'\n';
+	    plot="$plot\"$out_dir/data/$name.i$initial.u$update.dat\" using 1:2:4 title \"$name\" ls $ls with yerrorlines";
+	    ls=$((ls+1));
+	done;
+	cat << EOF >> $gp
+set title "Size: $initial / Update: $update / $runs runs, 95% confidence";
+set output "$out_dir/plots/i$initial.u$update.png";
+plot \\
+$plot
+EOF
+	gnuplot $gp;
+    done;
+done;
+
+source scripts/unlock_exec;
@@ -3,12 +3,36 @@
 source scripts/lock_exec;
 source scripts/config;
 
+dump=$(mktemp);
+
 for bin in $(ls out/test-*);
 do
     echo "Testing: $bin";
     $bin -n$max_cores | grep -i "expected";
     $bin -n$max_cores -i32 -r64 | grep -i "expected";
     $bin -n$max_cores -i16 -r32 -u100 | grep -i "expected";
+    # list_size against concurrent updates
+    $bin -n$max_cores -C -u100 -i1024 -r2048 | grep -i "size checks";
+    # bulk prefill, then a dump of the list loaded back
+    if $bin -B -d1 -r4 >/dev/null 2>&1;
+    then
+        $bin -n$max_cores -B -r4096 -S $dump | grep -i "expected";
+        $bin -n$max_cores -I $dump -r4096 | grep -i "expected";
+        $bin -n$max_cores -C -u100 -B -r40000 | grep -i "size checks";
+    fi;
+    # map operations, which abort on a wrong payload
+    if $bin -M -d1 -r4 >/dev/null 2>&1;
+    then
+        $bin -n$max_cores -M -u50 -i128 -r256 | grep -i "expected";
+    fi;
 done;
+rm -f $dump;
+
+# the same variants, linked into a single binary
+if [ -x out/lists ];
+then
+    echo "Testing: out/lists";
+    out/lists --impl=all -n$max_cores | grep -i "expected";
+fi;
 
 source scripts/unlock_exec;
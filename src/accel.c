@@ -0,0 +1,65 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "accel.h"
+
+__thread uint32_t accel_stale;
+
+void accel_init(accel_t *a, uint32_t threshold)
+{
+    memset(a, 0, sizeof(accel_t));
+    a->threshold = threshold;
+}
+
+void accel_destroy(accel_t *a)
+{
+    free(a->snap);
+    a->snap = NULL;
+}
+
+/* allocate a copy for up to capacity keys */
+static accel_snap_t *snap_new(size_t capacity)
+{
+    size_t nblocks = capacity / ACCEL_BLOCK + 1;
+    accel_snap_t *s;
+    if (posix_memalign((void **) &s, 64,
+                       sizeof(accel_snap_t) +
+                           nblocks * ACCEL_BLOCK * sizeof(val_t)) != 0)
+        abort();
+    s->nblocks = nblocks;
+    return s;
+}
+
+void accel_rebuild(accel_t *a, list_t *the_list)
+{
+    if (__atomic_load_n(&a->building, __ATOMIC_RELAXED) ||
+        CAS_U32(&a->building, 0, 1) != 0)
+        return;
+
+    /* no update may be under way when the copy is taken */
+    uint64_t stamp = __atomic_load_n(&a->started, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&a->finished, __ATOMIC_SEQ_CST) != stamp)
+        goto out;
+
+    size_t capacity = list_size_approx(the_list) + ACCEL_BLOCK;
+    accel_snap_t *s = snap_new(capacity);
+    int n = list_range(the_list, VAL_MIN + 1, VAL_MAX - 1, s->keys, capacity);
+    if (n > capacity ||
+        __atomic_load_n(&a->started, __ATOMIC_SEQ_CST) != stamp) {
+        free(s); /* the list changed, try again later */
+        goto out;
+    }
+
+    /* trim to the blocks in use and pad the last one */
+    s->nblocks = n / ACCEL_BLOCK + 1;
+    for (size_t i = n; i < s->nblocks * ACCEL_BLOCK; i++)
+        s->keys[i] = VAL_MAX;
+    s->stamp = stamp;
+
+    accel_snap_t *old = SWAP_PTR(&a->snap, s);
+    if (old)
+        reclaim_retire_block(old);
+    __atomic_fetch_add(&a->rebuilds, 1, __ATOMIC_RELAXED);
+out:
+    __atomic_store_n(&a->building, 0, __ATOMIC_RELEASE);
+}
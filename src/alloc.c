@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "alloc.h"
+#include "atomics.h"
+#include "utils.h"
+
+/* Size classes: 16, 32 and 64 bytes share cache lines without straddling
+ * them, larger nodes take a whole number of cache lines.
+ */
+#define CACHE_LINE 64
+#define NUM_CLASSES (3 + NODE_MAX_SIZE / CACHE_LINE - 1)
+
+/* the first cache line of a slab describes it */
+typedef struct slab {
+    uint32_t slot;     /* size of the slots carved from this slab */
+    struct slab *next; /* next slab mapped by the same thread */
+} slab_t;
+
+typedef struct free_node {
+    struct free_node *next;
+} free_node_t;
+
+typedef struct size_class {
+    free_node_t *free; /* freed slots, reused first */
+    char *cur, *end;   /* unused part of the current slab */
+} size_class_t;
+
+typedef struct alloc_thread {
+    size_class_t classes[NUM_CLASSES];
+    uint64_t allocs, frees, slabs;
+    size_t size;   /* largest size requested */
+    slab_t *mapped; /* slabs of this thread, for alloc_release */
+    struct alloc_thread *next;
+} ALIGNED(64) alloc_thread_t;
+
+static __thread alloc_thread_t *alloc_self;
+static alloc_thread_t *alloc_threads;
+static bool use_huge_pages;
+
+void alloc_huge_pages(bool enable)
+{
+    use_huge_pages = enable;
+}
+
+static alloc_thread_t *alloc_register(void)
+{
+    alloc_thread_t *self;
+    if (posix_memalign((void **) &self, 64, sizeof(alloc_thread_t)) != 0)
+        abort();
+    memset(self, 0, sizeof(alloc_thread_t));
+
+    alloc_thread_t *head;
+    do {
+        head = __atomic_load_n(&alloc_threads, __ATOMIC_ACQUIRE);
+        self->next = head;
+    } while (CAS_PTR(&alloc_threads, head, self) != head);
+
+    alloc_self = self;
+    return self;
+}
+
+static inline int size_to_class(size_t size)
+{
+    if (size <= 16)
+        return 0;
+    if (size <= 32)
+        return 1;
+    return 2 + (int) ((size - 1) / CACHE_LINE);
+}
+
+static inline uint32_t class_to_slot(int c)
+{
+    return c < 2 ? 16 << c : (c - 1) * CACHE_LINE;
+}
+
+/* map a new slab, aligned to SLAB_SIZE so that the header of the slab a
+ * node belongs to can be found by masking its address.
+ */
+static slab_t *slab_new(uint32_t slot)
+{
+    char *p = mmap(NULL, 2 * SLAB_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    char *slab =
+        (char *) (((uintptr_t) p + SLAB_SIZE - 1) & ~(SLAB_SIZE - 1));
+    if (slab > p)
+        munmap(p, slab - p);
+    munmap(slab + SLAB_SIZE, p + SLAB_SIZE - slab);
+#if defined(MADV_HUGEPAGE)
+    if (use_huge_pages)
+        madvise(slab, SLAB_SIZE, MADV_HUGEPAGE);
+#endif
+
+    ((slab_t *) slab)->slot = slot;
+    return (slab_t *) slab;
+}
+
+static inline void *alloc_slot(size_t size, bool reuse)
+{
+    alloc_thread_t *self = alloc_self;
+    if (__builtin_expect(!self, 0))
+        self = alloc_register();
+
+    if (size > NODE_MAX_SIZE) {
+        fprintf(stderr, "node_alloc: %zu bytes is too large\n", size);
+        abort();
+    }
+
+    int c = size_to_class(size);
+    size_class_t *sc = &self->classes[c];
+    self->allocs++;
+    if (size > self->size)
+        self->size = size;
+
+    free_node_t *node = sc->free;
+    if (reuse && node) {
+        sc->free = node->next;
+        return node;
+    }
+
+    uint32_t slot = class_to_slot(c);
+    if (sc->end - sc->cur < slot) {
+        slab_t *slab = slab_new(slot);
+        slab->next = self->mapped;
+        self->mapped = slab;
+        sc->cur = (char *) slab + CACHE_LINE;
+        sc->end = (char *) slab + SLAB_SIZE;
+        self->slabs++;
+    }
+    void *p = sc->cur;
+    sc->cur += slot;
+    return p;
+}
+
+void *node_alloc(size_t size)
+{
+    return alloc_slot(size, true);
+}
+
+void *node_alloc_sequential(size_t size)
+{
+    return alloc_slot(size, false);
+}
+
+void node_free(void *node)
+{
+    if (!node)
+        return;
+
+    alloc_thread_t *self = alloc_self;
+    if (__builtin_expect(!self, 0))
+        self = alloc_register();
+
+    slab_t *slab = (slab_t *) ((uintptr_t) node & ~(SLAB_SIZE - 1));
+    size_class_t *sc = &self->classes[size_to_class(slab->slot)];
+    free_node_t *f = node;
+    f->next = sc->free;
+    sc->free = f;
+    self->frees++;
+}
+
+void alloc_stats(alloc_stats_t *stats)
+{
+    memset(stats, 0, sizeof(alloc_stats_t));
+    alloc_thread_t *t = __atomic_load_n(&alloc_threads, __ATOMIC_ACQUIRE);
+    for (; t; t = t->next) {
+        stats->allocs += t->allocs;
+        stats->frees += t->frees;
+        stats->slabs += t->slabs;
+        if (t->size > stats->size)
+            stats->size = t->size;
+    }
+    if (stats->size)
+        stats->slot = class_to_slot(size_to_class(stats->size));
+}
+
+void alloc_release(void)
+{
+    alloc_thread_t *t = alloc_threads, *next;
+    for (; t; t = next) {
+        next = t->next;
+        slab_t *slab = t->mapped, *next_slab;
+        for (; slab; slab = next_slab) {
+            next_slab = slab->next;
+            munmap(slab, SLAB_SIZE);
+        }
+        free(t);
+    }
+    alloc_threads = NULL;
+    alloc_self = NULL;
+}
@@ -0,0 +1,11 @@
+#include "counter.h"
+
+__thread int counter_stripe = -1;
+
+int counter_assign(void)
+{
+    static uint32_t threads;
+    counter_stripe =
+        __atomic_fetch_add(&threads, 1, __ATOMIC_RELAXED) % COUNTER_STRIPES;
+    return counter_stripe;
+}
@@ -0,0 +1,142 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dist.h"
+
+/* fixed seed, so that the hot keys are the same from one run to the next */
+#define DIST_SEED 0x9e3779b97f4a7c15ULL
+
+int dist_parse(dist_t *d, const char *spec)
+{
+    static const char *names[] = {"uniform", "clustered", "sequential",
+                                  "monotonic", "zipf", "hotspot", "latest"};
+    memset(d, 0, sizeof(dist_t));
+    d->type = -1;
+    d->theta = DEFAULT_ZIPF_THETA;
+    double ops = DEFAULT_HOT_OPS;
+    d->hot_keys = DEFAULT_HOT_KEYS;
+
+    size_t len = strcspn(spec, ":");
+    for (int i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+        if (strlen(names[i]) == len && !strncmp(spec, names[i], len))
+            d->type = i;
+    if (d->type < 0)
+        return -1;
+
+    const char *params = spec[len] ? spec + len + 1 : NULL;
+    if (params) {
+        char extra;
+        if (d->type == DIST_ZIPF || d->type == DIST_LATEST) {
+            if (sscanf(params, "%lf%c", &d->theta, &extra) != 1 ||
+                d->theta < 0)
+                return -1;
+        } else if (d->type == DIST_HOTSPOT) {
+            if (sscanf(params, "%lf:%lf%c", &ops, &d->hot_keys, &extra) != 2 ||
+                ops < 0 || ops > 100 || d->hot_keys <= 0 || d->hot_keys > 100)
+                return -1;
+        } else {
+            return -1;
+        }
+    }
+    d->hot_ops = (uint32_t) fmin(ops / 100 * 4294967296.0, UINT32_MAX);
+    return 0;
+}
+
+static uint64_t split_mix(uint64_t *x)
+{
+    uint64_t z = (*x += DIST_SEED);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* build the alias table of the weights w (Vose's method), destroying w */
+static alias_t *alias_build(double *w, uint32_t n)
+{
+    alias_t *table = malloc(n * sizeof(alias_t));
+    uint32_t *small = malloc(n * sizeof(uint32_t));
+    uint32_t *large = malloc(n * sizeof(uint32_t));
+    uint32_t ns = 0, nl = 0;
+
+    double sum = 0;
+    for (uint32_t i = 0; i < n; i++)
+        sum += w[i];
+    for (uint32_t i = 0; i < n; i++) {
+        w[i] = w[i] * n / sum; /* 1 on average */
+        if (w[i] < 1)
+            small[ns++] = i;
+        else
+            large[nl++] = i;
+    }
+    while (ns && nl) {
+        uint32_t s = small[--ns], l = large[nl - 1];
+        table[s].prob = (uint32_t) (w[s] * 4294967296.0);
+        table[s].alias = l;
+        w[l] -= 1 - w[s];
+        if (w[l] < 1) {
+            nl--;
+            small[ns++] = l;
+        }
+    }
+    /* what is left has a weight of 1, up to rounding errors */
+    while (nl) {
+        uint32_t l = large[--nl];
+        table[l].prob = UINT32_MAX;
+        table[l].alias = l;
+    }
+    while (ns) {
+        uint32_t s = small[--ns];
+        table[s].prob = UINT32_MAX;
+        table[s].alias = s;
+    }
+    free(small);
+    free(large);
+    return table;
+}
+
+void dist_init(dist_t *d, uint32_t range)
+{
+    d->range = range;
+    d->counter = range - 1;
+
+    if (d->type == DIST_HOTSPOT) {
+        uint32_t hot = (uint32_t) (range * d->hot_keys / 100);
+        d->hot_n = hot ? hot : 1;
+        if (d->hot_n >= range)
+            d->type = DIST_UNIFORM;
+        /* in the middle of the range, neither the cheapest keys of a sorted
+         * list nor the most expensive ones
+         */
+        d->hot_lo = (range - d->hot_n) / 2;
+    }
+
+    if (d->type == DIST_ZIPF || d->type == DIST_LATEST) {
+        /* the weight of the key of rank i is 1 / (i + 1)^theta */
+        double *w = malloc(range * sizeof(double));
+        uint32_t *rank = malloc(range * sizeof(uint32_t));
+        for (uint32_t i = 0; i < range; i++)
+            rank[i] = i;
+        if (d->type == DIST_ZIPF) { /* spread the popular keys out */
+            uint64_t x = 0;
+            for (uint32_t i = range - 1; i > 0; i--) {
+                uint32_t j = split_mix(&x) % (i + 1);
+                uint32_t t = rank[i];
+                rank[i] = rank[j];
+                rank[j] = t;
+            }
+        }
+        for (uint32_t i = 0; i < range; i++)
+            w[i] = pow(rank[i] + 1.0, -d->theta);
+        d->table = alias_build(w, range);
+        free(rank);
+        free(w);
+    }
+}
+
+void dist_destroy(dist_t *d)
+{
+    free(d->table);
+    d->table = NULL;
+}
@@ -0,0 +1,97 @@
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dump.h"
+
+#if !defined(MAP_POPULATE)
+#define MAP_POPULATE 0
+#endif
+
+int dump_open(dump_t *d, const char *path)
+{
+    memset(d, 0, sizeof(dump_t));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    d->size = st.st_size;
+    if (d->size < sizeof(dump_header_t)) {
+        fprintf(stderr, "%s: not a dump file\n", path);
+        close(fd);
+        return -1;
+    }
+
+    /* the whole file is read by the bulk load, fault it in at once */
+    d->map = mmap(NULL, d->size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (d->map == MAP_FAILED) {
+        d->map = NULL;
+        perror(path);
+        return -1;
+    }
+
+    const dump_header_t *h = d->map;
+    const size_t record = sizeof(val_t) + sizeof(uint64_t);
+    bool valid = !memcmp(h->magic, DUMP_MAGIC, sizeof(h->magic)) &&
+                 h->count == (d->size - sizeof(dump_header_t)) / record &&
+                 (d->size - sizeof(dump_header_t)) % record == 0;
+    if (!valid) {
+        fprintf(stderr, "%s: not a valid dump file\n", path);
+        dump_close(d);
+        return -1;
+    }
+    d->count = h->count;
+    d->keys = (const val_t *) (h + 1);
+    d->payloads = (const uint64_t *) (d->keys + d->count);
+    return 0;
+}
+
+void dump_close(dump_t *d)
+{
+    if (d->map)
+        munmap(d->map, d->size);
+    d->map = NULL;
+}
+
+int dump_write(const char *path,
+               const val_t *keys,
+               const uint64_t *payloads,
+               uint64_t n)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    dump_header_t h = {.count = n};
+    memcpy(h.magic, DUMP_MAGIC, sizeof(h.magic));
+
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+              fwrite(keys, sizeof(val_t), n, f) == n;
+    if (payloads) {
+        ok = ok && fwrite(payloads, sizeof(uint64_t), n, f) == n;
+    } else {
+        const uint64_t zero = 0;
+        for (uint64_t i = 0; ok && i < n; i++)
+            ok = fwrite(&zero, sizeof(zero), 1, f) == 1;
+    }
+    if (fclose(f) != 0)
+        ok = false;
+    if (!ok) {
+        perror(path);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,233 @@
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "list.h"
+
+/* Flat combining (Hendler, Incze, Shavit, Tzafrir): the list itself is a
+ * sequential sorted list protected by a single lock. A thread posts its
+ * operation in its publication record and, if the lock is free, takes it and
+ * becomes the combiner: it collects the pending operations of all threads,
+ * sorts them by value and applies them all in one sweep over the list. The
+ * other threads wait for their record to be served, or for the lock to be
+ * released so that one of them can take over.
+ */
+
+/* number of passes over the publication records per combining session */
+#define FC_PASSES 3
+/* number of attempts before a waiting thread yields the processor */
+#define FC_SPIN_TRIES 1024
+
+#define FC_ADD 1
+#define FC_REMOVE 2
+#define FC_CONTAINS 3
+
+struct node {
+    val_t data;
+    struct node *next;
+};
+
+/* a publication record, one per thread and list; records are never removed */
+typedef struct fc_record {
+    volatile uint32_t pending; /* set by the owner, cleared by the combiner */
+    uint32_t op;
+    val_t val;
+    bool result;
+    struct fc_record *next;
+} ALIGNED(64) fc_record_t;
+
+struct list {
+    node_t *head, *tail;
+    uint64_t id; /* unique among the lists of the process */
+    uint32_t size;
+    uint32_t lock ALIGNED(64);
+    fc_record_t *records;
+};
+
+/* record of the calling thread for the list it used last, known by its id
+ * as a deleted list, and its records, may be reallocated
+ */
+static __thread uint64_t my_list;
+static __thread fc_record_t *my_record;
+
+static fc_record_t *get_record(list_t *the_list)
+{
+    if (__builtin_expect(my_list == the_list->id, 1))
+        return my_record;
+
+    fc_record_t *r;
+    if (posix_memalign((void **) &r, 64, sizeof(fc_record_t)) != 0)
+        abort();
+    memset(r, 0, sizeof(fc_record_t));
+    fc_record_t *head;
+    do {
+        head = __atomic_load_n(&the_list->records, __ATOMIC_ACQUIRE);
+        r->next = head;
+    } while (CAS_PTR(&the_list->records, head, r) != head);
+
+    /* the record of the previous list stays registered there */
+    my_list = the_list->id;
+    my_record = r;
+    return r;
+}
+
+static node_t *new_node(val_t val, node_t *next)
+{
+    node_t *node = node_alloc(sizeof(node_t));
+    node->data = val;
+    node->next = next;
+    return node;
+}
+
+static int compare_record(const void *a, const void *b)
+{
+    val_t x = (*(fc_record_t *const *) a)->val;
+    val_t y = (*(fc_record_t *const *) b)->val;
+    return (x > y) - (x < y);
+}
+
+/* apply the pending operations in one sweep; called with the lock held.
+ * @return the number of operations applied
+ */
+static int combine(list_t *the_list)
+{
+    static __thread fc_record_t **ops;
+    static __thread int capacity;
+
+    int n = 0;
+    for (fc_record_t *r = __atomic_load_n(&the_list->records, __ATOMIC_ACQUIRE);
+         r; r = r->next) {
+        if (!__atomic_load_n(&r->pending, __ATOMIC_ACQUIRE))
+            continue;
+        if (n == capacity) {
+            capacity = capacity ? 2 * capacity : 64;
+            ops = realloc(ops, capacity * sizeof(fc_record_t *));
+        }
+        ops[n++] = r;
+    }
+    if (!n)
+        return 0;
+    qsort(ops, n, sizeof(fc_record_t *), compare_record);
+
+    node_t *pred = the_list->head;
+    for (int i = 0; i < n; i++) {
+        fc_record_t *r = ops[i];
+        val_t val = r->val;
+        while (pred->next->data < val)
+            pred = pred->next;
+        node_t *curr = pred->next;
+        bool found = curr != the_list->tail && curr->data == val;
+
+        switch (r->op) {
+        case FC_ADD:
+            if (!found) {
+                pred->next = new_node(val, curr);
+                the_list->size++;
+            }
+            r->result = !found;
+            break;
+        case FC_REMOVE:
+            if (found) {
+                pred->next = curr->next;
+                node_free(curr);
+                the_list->size--;
+            }
+            r->result = found;
+            break;
+        default:
+            r->result = found;
+        }
+        __atomic_store_n(&r->pending, 0, __ATOMIC_RELEASE);
+    }
+    return n;
+}
+
+static bool fc_apply(list_t *the_list, uint32_t op, val_t val)
+{
+    fc_record_t *r = get_record(the_list);
+    r->op = op;
+    r->val = val;
+    __atomic_store_n(&r->pending, 1, __ATOMIC_RELEASE);
+
+    int tries = 0;
+    while (1) {
+        if (!__atomic_load_n(&the_list->lock, __ATOMIC_RELAXED) &&
+            CAS_U32(&the_list->lock, 0, 1) == 0) {
+            for (int pass = 0; pass < FC_PASSES; pass++)
+                if (!combine(the_list))
+                    break;
+            __atomic_store_n(&the_list->lock, 0, __ATOMIC_RELEASE);
+        }
+        if (!__atomic_load_n(&r->pending, __ATOMIC_ACQUIRE))
+            return r->result;
+
+        /* the combiner may not be running; let it make progress */
+        if (++tries == FC_SPIN_TRIES) {
+            sched_yield();
+            tries = 0;
+        }
+        cpu_relax();
+    }
+}
+
+bool list_contains(list_t *the_list, val_t val)
+{
+    return fc_apply(the_list, FC_CONTAINS, val);
+}
+
+bool list_add(list_t *the_list, val_t val)
+{
+    return fc_apply(the_list, FC_ADD, val);
+}
+
+bool list_remove(list_t *the_list, val_t val)
+{
+    return fc_apply(the_list, FC_REMOVE, val);
+}
+
+list_t *list_new()
+{
+    static uint64_t lists;
+
+    /* allocate list */
+    list_t *the_list;
+    if (posix_memalign((void **) &the_list, 64, sizeof(list_t)) != 0)
+        abort();
+
+    /* now need to create the sentinel nodes */
+    the_list->tail = new_node(VAL_MAX, NULL);
+    the_list->head = new_node(VAL_MIN, the_list->tail);
+    the_list->id = __atomic_add_fetch(&lists, 1, __ATOMIC_RELAXED);
+    the_list->size = 0;
+    the_list->lock = 0;
+    the_list->records = NULL;
+    return the_list;
+}
+
+/* free the list and all the nodes still linked in it; the caller must make
+ * sure no other thread is operating on the list.
+ */
+void list_delete(list_t *the_list)
+{
+    node_t *elem = the_list->head;
+    while (elem) {
+        node_t *next = elem->next;
+        node_free(elem);
+        elem = next;
+    }
+    fc_record_t *r = the_list->records;
+    while (r) {
+        fc_record_t *next = r->next;
+        free(r);
+        r = next;
+    }
+    free(the_list);
+}
+
+int list_size(list_t *the_list)
+{
+    return __atomic_load_n(&the_list->size, __ATOMIC_RELAXED);
+}
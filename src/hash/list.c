@@ -0,0 +1,190 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "harris.h"
+
+/* Split-ordered hash set (Shalev and Shavit): all the elements live in a
+ * single Harris list, sorted by the bit-reversed value of their key, so that
+ * the elements of a bucket stay contiguous whatever the number of buckets.
+ * Each bucket starts with a dummy node, and doubling the table only needs to
+ * insert new dummy nodes, which is done lazily by the first operation that
+ * uses a bucket. Elements never move.
+ *
+ * The hash function is the identity: bucket b holds the keys equal to b
+ * modulo the table size. Keys must be within [0, 2^62).
+ */
+#define MAX_LOAD 2     /* average number of elements per bucket */
+#define MAX_SEGMENTS 48 /* up to 2^47 buckets */
+
+struct list {
+    node_t *tail;                   /* end of the list, compared by address */
+    node_t **segments[MAX_SEGMENTS]; /* bucket directory, see get_bucket */
+    uint64_t nbuckets;              /* a power of 2, only grows */
+    uint32_t size;
+};
+
+static inline uint64_t reverse63(uint64_t x)
+{
+    x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+    x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+    x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    x = __builtin_bswap64(x);
+    return x >> 1; /* keep the order keys positive as a val_t */
+}
+
+/* order keys: the lowest bit tells regular nodes (1) from dummy nodes (0),
+ * so that the dummy node of a bucket precedes all the elements of the bucket.
+ */
+static inline val_t so_regular(val_t key)
+{
+    return reverse63(key) | 1;
+}
+
+/* the order keys drop the two upper bits of the keys, so only the keys
+ * within [0, 2^62) can be told apart; the others are rejected.
+ */
+static inline bool so_valid(val_t key)
+{
+    return (uint64_t) key < (1ULL << 62);
+}
+
+static inline val_t so_dummy(uint64_t bucket)
+{
+    return reverse63(bucket);
+}
+
+/* the parent of a bucket is the bucket it was split from */
+static inline uint64_t parent_bucket(uint64_t bucket)
+{
+    return bucket & ~(1ULL << (63 - __builtin_clzll(bucket)));
+}
+
+/* Segment 0 holds bucket 0 and segment s > 0 holds buckets [2^(s-1), 2^s),
+ * so the directory never needs to be copied when the table grows. Segments
+ * are allocated on first use.
+ * @return the slot of the bucket, NULL until the bucket is initialized
+ */
+static node_t **get_bucket(list_t *set, uint64_t bucket)
+{
+    int seg = bucket ? 64 - __builtin_clzll(bucket) : 0;
+    uint64_t first = seg ? 1ULL << (seg - 1) : 0;
+    node_t **segment = __atomic_load_n(&set->segments[seg], __ATOMIC_ACQUIRE);
+    if (__builtin_expect(!segment, 0)) {
+        uint64_t len = seg ? 1ULL << (seg - 1) : 1;
+        node_t **fresh = calloc(len, sizeof(node_t *));
+        if (!fresh)
+            abort();
+        segment = CAS_PTR(&set->segments[seg], NULL, fresh);
+        if (segment) /* somebody else installed it first */
+            free(fresh);
+        else
+            segment = fresh;
+    }
+    return &segment[bucket - first];
+}
+
+/* insert the dummy node of bucket in the list, after the one of its parent */
+static node_t *initialize_bucket(list_t *set, uint64_t bucket)
+{
+    node_t **slot = get_bucket(set, bucket);
+    node_t *dummy = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+    if (dummy)
+        return dummy;
+
+    node_t *parent = initialize_bucket(set, parent_bucket(bucket));
+    /* if another thread inserted it first, we get its node */
+    harris_insert(parent, set->tail, so_dummy(bucket), &dummy);
+    __atomic_store_n(slot, dummy, __ATOMIC_RELEASE);
+    return dummy;
+}
+
+static inline node_t *bucket_of(list_t *set, val_t key)
+{
+    uint64_t nbuckets = __atomic_load_n(&set->nbuckets, __ATOMIC_RELAXED);
+    uint64_t bucket = (uint64_t) key & (nbuckets - 1);
+    node_t *dummy = __atomic_load_n(get_bucket(set, bucket), __ATOMIC_ACQUIRE);
+    if (__builtin_expect(!dummy, 0))
+        dummy = initialize_bucket(set, bucket);
+    return dummy;
+}
+
+/* return true if there is a node in the list owning value val. */
+bool list_contains(list_t *the_list, val_t val)
+{
+    if (!so_valid(val))
+        return false;
+    reclaim_enter();
+    bool found = harris_contains(bucket_of(the_list, val), the_list->tail,
+                                 so_regular(val));
+    reclaim_exit();
+    return found;
+}
+
+list_t *list_new()
+{
+    /* allocate list */
+    list_t *the_list = calloc(1, sizeof(list_t));
+
+    /* the dummy node of bucket 0 is the head of the list */
+    the_list->tail = new_node(VAL_MAX, NULL);
+    *get_bucket(the_list, 0) = new_node(so_dummy(0), the_list->tail);
+    the_list->nbuckets = 2;
+    the_list->size = 0;
+    return the_list;
+}
+
+/* free the list and all the nodes still linked in it; the caller must make
+ * sure no other thread is operating on the list.
+ */
+void list_delete(list_t *the_list)
+{
+    node_t *elem = *get_bucket(the_list, 0);
+    while (elem != the_list->tail) {
+        node_t *next = get_unmarked_ref(elem->next);
+        node_free(elem);
+        elem = next;
+    }
+    node_free(the_list->tail);
+    for (int i = 0; i < MAX_SEGMENTS; i++)
+        free(the_list->segments[i]);
+    free(the_list);
+}
+
+int list_size(list_t *the_list)
+{
+    return the_list->size;
+}
+
+bool list_add(list_t *the_list, val_t val)
+{
+    node_t *node;
+    if (!so_valid(val))
+        return false;
+    reclaim_enter();
+    bool added = harris_insert(bucket_of(the_list, val), the_list->tail,
+                               so_regular(val), &node);
+    if (added) {
+        uint32_t size = IAF_U32(&(the_list->size));
+        uint64_t nbuckets = the_list->nbuckets;
+        /* double the table; the new buckets are initialized on demand */
+        if (size / nbuckets > MAX_LOAD &&
+            nbuckets < 1ULL << (MAX_SEGMENTS - 1))
+            CAS_U64(&the_list->nbuckets, nbuckets, nbuckets * 2);
+    }
+    reclaim_exit();
+    return added;
+}
+
+bool list_remove(list_t *the_list, val_t val)
+{
+    if (!so_valid(val))
+        return false;
+    reclaim_enter();
+    bool removed = harris_remove(bucket_of(the_list, val), the_list->tail,
+                                 so_regular(val));
+    if (removed)
+        FAD_U32(&(the_list->size));
+    reclaim_exit();
+    return removed;
+}
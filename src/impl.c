@@ -0,0 +1,21 @@
+/* descriptor of the variant this file is compiled for, named IMPL_NAME and
+ * exported as IMPL_SYM (include/registry.h)
+ */
+#include "list.h"
+#include "registry.h"
+
+int main(int argc, char *const argv[]);
+
+const impl_t IMPL_SYM IMPL_SECTION = {
+    .name = IMPL_NAME,
+    .ops =
+        {
+            .new = list_new,
+            .delete = list_delete,
+            .contains = list_contains,
+            .add = list_add,
+            .remove = list_remove,
+            .size = list_size,
+        },
+    .run = main,
+};
@@ -0,0 +1,304 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "alloc.h"
+#include "list.h"
+#include "reclaim.h"
+
+/* Lazy list: traversals never take locks, updates lock the two nodes around
+ * the position of val and validate them before changing anything. A node is
+ * first marked as logically deleted and only then unlinked, so a node that
+ * is reachable and not marked is in the set, which makes list_contains
+ * wait-free. Since readers do not synchronize with updates, unlinked nodes
+ * are retired through the reclamation scheme.
+ */
+struct node {
+    val_t data;
+    struct node *next;
+    ptlock_t lock;       /* lock for this entry */
+    volatile bool marked; /* logically deleted */
+};
+
+struct list {
+    node_t *head, *tail;
+    uint32_t size;
+};
+
+/* pred and curr are still adjacent and neither was deleted; the caller must
+ * hold the locks of both.
+ */
+static inline bool validate(node_t *pred, node_t *curr)
+{
+    return !pred->marked && !curr->marked && pred->next == curr;
+}
+
+/* list_locate sets pred to the node owning the value immediately lower than
+ * val, and curr to its successor, owning val or a higher value. The search
+ * starts from node start, which must own a lower value.
+ */
+static inline void list_locate(node_t *start,
+                               val_t val,
+                               node_t **pred,
+                               node_t **curr)
+{
+    node_t *p = start;
+    node_t *c = __atomic_load_n(&p->next, __ATOMIC_ACQUIRE);
+    while (c->data < val) {
+        p = c;
+        c = __atomic_load_n(&c->next, __ATOMIC_ACQUIRE);
+    }
+    *pred = p;
+    *curr = c;
+}
+
+/* return true if there is a node in the list owning value val. */
+bool list_contains(list_t *the_list, val_t val)
+{
+    reclaim_enter();
+    node_t *curr = the_list->head;
+    while (curr->data < val)
+        curr = __atomic_load_n(&curr->next, __ATOMIC_ACQUIRE);
+    bool found = curr->data == val && !curr->marked;
+    reclaim_exit();
+    return found;
+}
+
+static node_t *new_node(val_t val, node_t *next)
+{
+    node_t *node = node_alloc(sizeof(node_t));
+    INIT_LOCK(&node->lock);
+    node->data = val;
+    node->next = next;
+    node->marked = false;
+    return node;
+}
+
+list_t *list_new()
+{
+    /* allocate list */
+    list_t *the_list = malloc(sizeof(list_t));
+
+    /* now need to create the sentinel nodes */
+    the_list->tail = new_node(VAL_MAX, NULL);
+    the_list->head = new_node(VAL_MIN, the_list->tail);
+    the_list->size = 0;
+    return the_list;
+}
+
+/* free the list and all the nodes still linked in it; the caller must make
+ * sure no other thread is operating on the list.
+ */
+void list_delete(list_t *the_list)
+{
+    node_t *elem = the_list->head;
+    while (elem) {
+        node_t *next = elem->next;
+        DESTROY_LOCK(&elem->lock);
+        node_free(elem);
+        elem = next;
+    }
+    free(the_list);
+}
+
+int list_size(list_t *the_list)
+{
+    return the_list->size;
+}
+
+bool list_add(list_t *the_list, val_t val)
+{
+    node_t *pred, *curr;
+    bool result;
+    reclaim_enter();
+    while (1) {
+        list_locate(the_list->head, val, &pred, &curr);
+        LOCK(&pred->lock);
+        LOCK(&curr->lock);
+        if (validate(pred, curr)) {
+            result = curr->data != val;
+            if (result) {
+                node_t *new_elem = new_node(val, curr);
+                __atomic_store_n(&pred->next, new_elem, __ATOMIC_RELEASE);
+                FAI_U32(&(the_list->size));
+            }
+            UNLOCK(&curr->lock);
+            UNLOCK(&pred->lock);
+            break;
+        }
+        /* somebody changed the list in between, start over */
+        UNLOCK(&curr->lock);
+        UNLOCK(&pred->lock);
+    }
+    reclaim_exit();
+    return result;
+}
+
+bool list_remove(list_t *the_list, val_t val)
+{
+    node_t *pred, *curr;
+    bool result;
+    reclaim_enter();
+    while (1) {
+        list_locate(the_list->head, val, &pred, &curr);
+        LOCK(&pred->lock);
+        LOCK(&curr->lock);
+        if (validate(pred, curr)) {
+            result = curr->data == val;
+            if (result) {
+                curr->marked = true; /* logical deletion */
+                __atomic_store_n(&pred->next, curr->next, __ATOMIC_RELEASE);
+                FAD_U32(&(the_list->size));
+            }
+            UNLOCK(&curr->lock);
+            UNLOCK(&pred->lock);
+            /* threads waiting on its lock will fail to validate it */
+            if (result)
+                reclaim_retire(curr);
+            break;
+        }
+        UNLOCK(&curr->lock);
+        UNLOCK(&pred->lock);
+    }
+    reclaim_exit();
+    return result;
+}
+
+#if defined(LIST_RANGE)
+/* Lock the node before lo and then every node of the range, left to right as
+ * the updates do, and keep the locks until the end of the query: an update
+ * within the range needs the lock of its predecessor, which is either held or
+ * behind us (two-phase locking).
+ */
+int list_range(list_t *the_list, val_t lo, val_t hi, val_t *buf, int max)
+{
+    node_t *pred, *curr;
+    reclaim_enter();
+    while (1) {
+        list_locate(the_list->head, lo, &pred, &curr);
+        LOCK(&pred->lock);
+        if (!pred->marked)
+            break;
+        UNLOCK(&pred->lock);
+    }
+
+    /* nodes may have been inserted after pred in the meantime */
+    curr = pred->next;
+    while (curr->data < lo) {
+        LOCK(&curr->lock);
+        UNLOCK(&pred->lock);
+        pred = curr;
+        curr = pred->next;
+    }
+
+    node_t *last = pred;
+    int n = 0;
+    while (curr != the_list->tail && curr->data <= hi) {
+        LOCK(&curr->lock);
+        if (n < max)
+            buf[n] = curr->data;
+        n++;
+        last = curr;
+        curr = curr->next;
+    }
+
+    for (node_t *elem = pred; elem != last;) {
+        node_t *next = elem->next;
+        UNLOCK(&elem->lock);
+        elem = next;
+    }
+    UNLOCK(&last->lock);
+    reclaim_exit();
+    return n;
+}
+#endif
+
+#if defined(LIST_BATCH)
+/* The batched operations search each value from the node before the previous
+ * one, unless it was removed in the meantime or the values are not sorted.
+ */
+static inline node_t *batch_start(list_t *the_list,
+                                  node_t *pred,
+                                  const val_t *vals,
+                                  int i)
+{
+    if (pred->marked || (i > 0 && vals[i] < vals[i - 1]))
+        return the_list->head;
+    return pred;
+}
+
+int list_add_batch(list_t *the_list, const val_t *vals, int n)
+{
+    node_t *pred = the_list->head, *curr;
+    int added = 0;
+    reclaim_enter();
+    for (int i = 0; i < n; i++) {
+        while (1) {
+            list_locate(batch_start(the_list, pred, vals, i), vals[i], &pred,
+                        &curr);
+            LOCK(&pred->lock);
+            LOCK(&curr->lock);
+            if (validate(pred, curr))
+                break;
+            UNLOCK(&curr->lock);
+            UNLOCK(&pred->lock);
+        }
+        if (curr->data != vals[i]) {
+            __atomic_store_n(&pred->next, new_node(vals[i], curr),
+                             __ATOMIC_RELEASE);
+            added++;
+        }
+        UNLOCK(&curr->lock);
+        UNLOCK(&pred->lock);
+    }
+    __atomic_fetch_add(&the_list->size, added, __ATOMIC_RELAXED);
+    reclaim_exit();
+    return added;
+}
+
+int list_remove_batch(list_t *the_list, const val_t *vals, int n)
+{
+    node_t *pred = the_list->head, *curr;
+    int removed = 0;
+    reclaim_enter();
+    for (int i = 0; i < n; i++) {
+        while (1) {
+            list_locate(batch_start(the_list, pred, vals, i), vals[i], &pred,
+                        &curr);
+            LOCK(&pred->lock);
+            LOCK(&curr->lock);
+            if (validate(pred, curr))
+                break;
+            UNLOCK(&curr->lock);
+            UNLOCK(&pred->lock);
+        }
+        bool found = curr->data == vals[i];
+        if (found) {
+            curr->marked = true; /* logical deletion */
+            __atomic_store_n(&pred->next, curr->next, __ATOMIC_RELEASE);
+            removed++;
+        }
+        UNLOCK(&curr->lock);
+        UNLOCK(&pred->lock);
+        if (found)
+            reclaim_retire(curr);
+    }
+    __atomic_fetch_sub(&the_list->size, removed, __ATOMIC_RELAXED);
+    reclaim_exit();
+    return removed;
+}
+
+int list_contains_batch(list_t *the_list, const val_t *vals, int n)
+{
+    node_t *pred = the_list->head, *curr;
+    int found = 0;
+    reclaim_enter();
+    for (int i = 0; i < n; i++) {
+        list_locate(batch_start(the_list, pred, vals, i), vals[i], &pred,
+                    &curr);
+        found += curr->data == vals[i] && !curr->marked;
+    }
+    reclaim_exit();
+    return found;
+}
+#endif
@@ -1,71 +1,89 @@
+#include "alloc.h"
+#include "counter.h"
 #include "list.h"
+#if defined(LIST_BULK)
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dump.h"
+#endif
 
 struct node {
     val_t data;
     struct node *next;
-    ptlock_t *lock; /* lock for this entry */
+#if defined(LIST_MAP)
+    payload_t payload; /* protected by the lock of the previous node */
+#endif
+    ptlock_t lock; /* lock for this entry, kept in the node's cache line */
 };
 
 struct list {
     node_t *head;
+    counter_t size; /* updated by every successful update */
 };
 
 bool list_contains(list_t *the_list, val_t val)
 {
     /* lock sentinel node */
     node_t *elem = the_list->head;
-    LOCK(elem->lock);
+    LOCK(&elem->lock);
     if (!elem->next) { /* the list is empty */
-        UNLOCK(elem->lock);
+        UNLOCK(&elem->lock);
         return false;
     }
 
     node_t *prev = elem;
     while (elem->next && elem->next->data <= val) {
         if (elem->next->data == val) { /* found it */
-            UNLOCK(elem->lock);
+            UNLOCK(&elem->lock);
             return true;
         }
         prev = elem;
         elem = elem->next;
-        LOCK(elem->lock);
-        UNLOCK(prev->lock);
+        STAT_INC(traversed);
+        LOCK(&elem->lock);
+        UNLOCK(&prev->lock);
     }
 
     /* just check if the last node in the list is not equal to val */
     if (elem->data == val) { /* found */
-        UNLOCK(elem->lock);
+        UNLOCK(&elem->lock);
         return true;
     }
 
     /* not found in the list */
-    UNLOCK(elem->lock);
+    UNLOCK(&elem->lock);
     return false;
 }
 
-static node_t *new_node(val_t val, node_t *next)
+static node_t *init_node(node_t *node, val_t val, node_t *next)
 {
-    /* allocate node */
-    node_t *node = malloc(sizeof(node_t));
-
-    /* allocate lock */
-    node->lock = malloc(sizeof(ptlock_t));
-
     /* initialize the lock */
-    INIT_LOCK(node->lock);
+    INIT_LOCK(&node->lock);
 
     node->data = val;
     node->next = next;
+#if defined(LIST_MAP)
+    node->payload = 0;
+#endif
     return node;
 }
 
+static node_t *new_node(val_t val, node_t *next)
+{
+    return init_node(node_alloc(sizeof(node_t)), val, next);
+}
+
 list_t *list_new()
 {
     /* allocate list */
-    list_t *the_list = malloc(sizeof(list_t));
+    list_t *the_list;
+    if (posix_memalign((void **) &the_list, 64, sizeof(list_t)) != 0)
+        abort();
 
     /* now need to create the sentinel node */
-    the_list->head = new_node(0, NULL);
+    the_list->head = new_node(VAL_MIN, NULL);
+    counter_init(&the_list->size, 0);
     return the_list;
 }
 
@@ -73,18 +91,17 @@ void list_delete(list_t *the_list)
 {
     /* must lock the whole list */
     node_t *elem = the_list->head;
-    LOCK(elem->lock);
+    LOCK(&elem->lock);
     if (!elem->next) { /* an empty list, just delete sentinel node */
-        UNLOCK(elem->lock);
-        DESTROY_LOCK(elem->lock);
+        UNLOCK(&elem->lock);
+        DESTROY_LOCK(&elem->lock);
 
         /* deallocate memory and we are done */
-        free(elem->lock);
-        free(elem);
+        node_free(elem);
     } else { /* have to go through list */
         while (elem->next) {
             /* lock everything */
-            LOCK(elem->next->lock);
+            LOCK(&elem->next->lock);
             elem = elem->next;
         }
 
@@ -93,42 +110,47 @@ void list_delete(list_t *the_list)
             elem = the_list->head;
             the_list->head = elem->next;
 
-            UNLOCK(elem->lock);
-            DESTROY_LOCK(elem->lock);
+            UNLOCK(&elem->lock);
+            DESTROY_LOCK(&elem->lock);
 
-            free(elem->lock);
-            free(elem);
+            node_free(elem);
         }
     }
 
     free(the_list);
 }
 
+int list_size_approx(list_t *the_list)
+{
+    int64_t size = counter_read(&the_list->size);
+    /* a removal may be counted before the insertion of its value */
+    return size > 0 ? size : 0;
+}
+
+/* Locks are kept on every node until all of them are counted, as by
+ * list_range, so that no update can happen meanwhile and the size is
+ * linearizable.
+ */
 int list_size(list_t *the_list)
 {
     int size = 0;
-    /* must lock the whole list */
-    node_t *prev = the_list->head;
-    LOCK(prev->lock);
-    if (!prev->next) { /* the list is empty */
-        UNLOCK(prev->lock);
-        return size;
-    }
-
-    node_t *elem = prev->next;
-    LOCK(elem->lock);
-    size++;
+    node_t *elem = the_list->head;
+    LOCK(&elem->lock);
     while (elem->next) {
-        size++;
-        UNLOCK(prev->lock);
-        prev = elem;
         elem = elem->next;
-        LOCK(elem->lock);
+        LOCK(&elem->lock);
+        size++;
     }
 
-    /* we did not find it; unlock and report failure */
-    UNLOCK(elem->lock);
-    UNLOCK(prev->lock);
+    /* release the locks, which keep the next pointers stable meanwhile */
+    node_t *last = elem;
+    elem = the_list->head;
+    while (elem != last) {
+        node_t *next = elem->next;
+        UNLOCK(&elem->lock);
+        elem = next;
+    }
+    UNLOCK(&last->lock);
     return size;
 }
 
@@ -136,11 +158,12 @@ bool list_add(list_t *the_list, val_t val)
 {
     /* lock sentinel node */
     node_t *elem = the_list->head;
-    LOCK(elem->lock);
+    LOCK(&elem->lock);
     if (!elem->next) { /* the list is empty */
         node_t *new_elem = new_node(val, NULL);
         elem->next = new_elem;
-        UNLOCK(elem->lock);
+        UNLOCK(&elem->lock);
+        counter_add(&the_list->size, 1);
         return true;
     }
 
@@ -149,17 +172,18 @@ bool list_add(list_t *the_list, val_t val)
     while (elem->next && elem->next->data <= val) {
         if (elem->next->data == val) {
             /* we already have that value, unlock and report failure */
-            UNLOCK(elem->lock);
+            UNLOCK(&elem->lock);
             return false;
         }
         prev = elem;
         elem = elem->next;
-        LOCK(elem->lock);
-        UNLOCK(prev->lock);
+        STAT_INC(traversed);
+        LOCK(&elem->lock);
+        UNLOCK(&prev->lock);
     }
     /* just check if the last node in the list is not equal to val */
     if (elem->data == val) { /* if equal report failure */
-        UNLOCK(elem->lock);
+        UNLOCK(&elem->lock);
         return false;
     }
 
@@ -168,7 +192,8 @@ bool list_add(list_t *the_list, val_t val)
     elem->next = new_elem;
 
     /* successfully added new value, unlock elem */
-    UNLOCK(elem->lock);
+    UNLOCK(&elem->lock);
+    counter_add(&the_list->size, 1);
     return true;
 }
 
@@ -176,33 +201,34 @@ bool list_remove(list_t *the_list, val_t val)
 {
     /* lock sentinel node */
     node_t *prev = the_list->head;
-    LOCK(prev->lock);
+    LOCK(&prev->lock);
     if (!prev->next) { /* the list is empty */
-        UNLOCK(prev->lock);
+        UNLOCK(&prev->lock);
         return false;
     }
 
     node_t *elem = prev->next;
-    LOCK(elem->lock);
+    LOCK(&elem->lock);
     while (elem->next && elem->data <= val) {
         if (elem->data == val) {
             /* if found, assign prev next to elem next */
             prev->next = elem->next;
 
             /* unlock and deallocate mem */
-            UNLOCK(elem->lock);
-            DESTROY_LOCK(elem->lock);
-            free(elem->lock);
-            free(elem);
+            UNLOCK(&elem->lock);
+            DESTROY_LOCK(&elem->lock);
+            node_free(elem);
 
             /* success */
-            UNLOCK(prev->lock);
+            UNLOCK(&prev->lock);
+            counter_add(&the_list->size, -1);
             return true;
         }
-        UNLOCK(prev->lock);
+        UNLOCK(&prev->lock);
         prev = elem;
         elem = elem->next;
-        LOCK(elem->lock);
+        STAT_INC(traversed);
+        LOCK(&elem->lock);
     }
 
     /* just check if the last node in the list is not equal to val */
@@ -211,18 +237,326 @@ bool list_remove(list_t *the_list, val_t val)
         prev->next = elem->next;
 
         /* unlock and deallocate mem */
-        UNLOCK(elem->lock);
-        DESTROY_LOCK(elem->lock);
-        free(elem->lock);
-        free(elem);
+        UNLOCK(&elem->lock);
+        DESTROY_LOCK(&elem->lock);
+        node_free(elem);
 
         /* success */
-        UNLOCK(prev->lock);
+        UNLOCK(&prev->lock);
+        counter_add(&the_list->size, -1);
         return true;
     }
 
     /* we did not find it; unlock and report failure */
-    UNLOCK(elem->lock);
-    UNLOCK(prev->lock);
+    UNLOCK(&elem->lock);
+    UNLOCK(&prev->lock);
     return false;
 }
+
+#if defined(LIST_BULK)
+/* link n nodes, allocated in key order, after the sentinel of an empty list;
+ * payloads may be NULL.
+ */
+static list_t *build(const val_t *keys, const uint64_t *payloads, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        if (keys[i] == VAL_MIN || keys[i] == VAL_MAX ||
+            (i > 0 && keys[i] <= keys[i - 1]))
+            return NULL;
+
+    list_t *the_list = list_new();
+    node_t *prev = the_list->head;
+    for (size_t i = 0; i < n; i++) {
+        node_t *node = init_node(node_alloc_sequential(sizeof(node_t)),
+                                 keys[i], NULL);
+#if defined(LIST_MAP)
+        if (payloads)
+            node->payload = payloads[i];
+#endif
+        prev->next = node;
+        prev = node;
+    }
+    counter_init(&the_list->size, n);
+    /* publish the nodes along with the list */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return the_list;
+}
+
+list_t *list_build_from_sorted(const val_t *keys, size_t n)
+{
+    return build(keys, NULL, n);
+}
+
+/* the nodes are locked hand over hand, as by list_contains */
+int list_save(list_t *the_list, const char *path)
+{
+    size_t n = 0, capacity = 1024;
+    val_t *keys = malloc(capacity * sizeof(val_t));
+    uint64_t *payloads = malloc(capacity * sizeof(uint64_t));
+    node_t *elem = the_list->head;
+    LOCK(&elem->lock);
+    while (elem->next) {
+        node_t *prev = elem;
+        elem = elem->next;
+        LOCK(&elem->lock);
+        UNLOCK(&prev->lock);
+        if (n == capacity) {
+            capacity *= 2;
+            keys = realloc(keys, capacity * sizeof(val_t));
+            payloads = realloc(payloads, capacity * sizeof(uint64_t));
+        }
+        keys[n] = elem->data;
+#if defined(LIST_MAP)
+        payloads[n] = elem->payload;
+#else
+        payloads[n] = 0;
+#endif
+        n++;
+    }
+    UNLOCK(&elem->lock);
+
+    int ret = dump_write(path, keys, payloads, n);
+    free(keys);
+    free(payloads);
+    return ret;
+}
+
+list_t *list_load(const char *path)
+{
+    dump_t d;
+    if (dump_open(&d, path) != 0)
+        return NULL;
+    list_t *the_list = build(d.keys, d.payloads, d.count);
+    dump_close(&d);
+    if (!the_list)
+        fprintf(stderr, "%s: the keys are not sorted\n", path);
+    return the_list;
+}
+
+/* The first node is unlinked while both the sentinel and the node are
+ * locked, as by list_remove, until there is none.
+ */
+int list_clear(list_t *the_list)
+{
+    int removed = 0;
+    node_t *head = the_list->head;
+    LOCK(&head->lock);
+    while (head->next) {
+        node_t *elem = head->next;
+        /* wait for the threads that may still be reading it */
+        LOCK(&elem->lock);
+        head->next = elem->next;
+        UNLOCK(&elem->lock);
+        DESTROY_LOCK(&elem->lock);
+        node_free(elem);
+        removed++;
+    }
+    UNLOCK(&head->lock);
+    counter_add(&the_list->size, -removed);
+    return removed;
+}
+#endif
+
+#if defined(LIST_MAP)
+/* The map operations lock the nodes hand over hand up to the node before
+ * key, and keep its lock while they read or write the payload of the node
+ * owning key: removals hold the same lock to unlink that node.
+ * @return the node before key, locked
+ */
+static node_t *map_seek(list_t *the_list, val_t key)
+{
+    node_t *elem = the_list->head;
+    LOCK(&elem->lock);
+    while (elem->next && elem->next->data < key) {
+        node_t *prev = elem;
+        elem = elem->next;
+        STAT_INC(traversed);
+        LOCK(&elem->lock);
+        UNLOCK(&prev->lock);
+    }
+    return elem;
+}
+
+bool list_get(list_t *the_list, val_t key, payload_t *payload)
+{
+    node_t *prev = map_seek(the_list, key);
+    node_t *elem = prev->next;
+    bool found = elem && elem->data == key;
+    if (found)
+        *payload = elem->payload;
+    UNLOCK(&prev->lock);
+    return found;
+}
+
+bool list_put(list_t *the_list, val_t key, payload_t payload, payload_t *old)
+{
+    node_t *prev = map_seek(the_list, key);
+    node_t *elem = prev->next;
+    bool absent = !elem || elem->data != key;
+    if (absent) {
+        elem = new_node(key, elem);
+        elem->payload = payload;
+        prev->next = elem;
+    } else {
+        if (old)
+            *old = elem->payload;
+        elem->payload = payload;
+    }
+    UNLOCK(&prev->lock);
+    if (absent)
+        counter_add(&the_list->size, 1);
+    return absent;
+}
+
+bool list_put_if_absent(list_t *the_list,
+                        val_t key,
+                        payload_t payload,
+                        payload_t *current)
+{
+    node_t *prev = map_seek(the_list, key);
+    node_t *elem = prev->next;
+    bool absent = !elem || elem->data != key;
+    if (absent) {
+        elem = new_node(key, elem);
+        elem->payload = payload;
+        prev->next = elem;
+    } else if (current) {
+        *current = elem->payload;
+    }
+    UNLOCK(&prev->lock);
+    if (absent)
+        counter_add(&the_list->size, 1);
+    return absent;
+}
+
+bool list_replace(list_t *the_list,
+                  val_t key,
+                  payload_t expected,
+                  payload_t payload)
+{
+    node_t *prev = map_seek(the_list, key);
+    node_t *elem = prev->next;
+    bool replaced = elem && elem->data == key && elem->payload == expected;
+    if (replaced)
+        elem->payload = payload;
+    UNLOCK(&prev->lock);
+    return replaced;
+}
+#endif
+
+#if defined(LIST_RANGE)
+/* Locks are taken hand over hand up to the node before lo, and then kept on
+ * every node of the range until the end of the query, so that no update can
+ * happen within the range while it is read (two-phase locking).
+ */
+int list_range(list_t *the_list, val_t lo, val_t hi, val_t *buf, int max)
+{
+    node_t *elem = the_list->head;
+    LOCK(&elem->lock);
+    while (elem->next && elem->next->data < lo) {
+        node_t *prev = elem;
+        elem = elem->next;
+        LOCK(&elem->lock);
+        UNLOCK(&prev->lock);
+    }
+
+    node_t *first = elem;
+    int n = 0;
+    while (elem->next && elem->next->data <= hi) {
+        elem = elem->next;
+        LOCK(&elem->lock);
+        if (n < max)
+            buf[n] = elem->data;
+        n++;
+    }
+
+    /* release the locks, which keep the next pointers stable meanwhile */
+    node_t *last = elem;
+    elem = first;
+    while (elem != last) {
+        node_t *next = elem->next;
+        UNLOCK(&elem->lock);
+        elem = next;
+    }
+    UNLOCK(&last->lock);
+    return n;
+}
+#endif
+
+#if defined(LIST_BATCH)
+/* The batched operations keep the lock of the node before the current value
+ * and move it forward hand over hand, so the values are handled in a single
+ * traversal; unsorted values make it start over from the head.
+ */
+static inline node_t *batch_seek(list_t *the_list,
+                                 node_t *elem,
+                                 const val_t *vals,
+                                 int i)
+{
+    if (i > 0 && vals[i] < vals[i - 1]) {
+        UNLOCK(&elem->lock);
+        elem = the_list->head;
+        LOCK(&elem->lock);
+    }
+    while (elem->next && elem->next->data < vals[i]) {
+        node_t *prev = elem;
+        elem = elem->next;
+        LOCK(&elem->lock);
+        UNLOCK(&prev->lock);
+    }
+    return elem;
+}
+
+int list_add_batch(list_t *the_list, const val_t *vals, int n)
+{
+    int added = 0;
+    node_t *elem = the_list->head;
+    LOCK(&elem->lock);
+    for (int i = 0; i < n; i++) {
+        elem = batch_seek(the_list, elem, vals, i);
+        if (elem->next && elem->next->data == vals[i])
+            continue;
+        elem->next = new_node(vals[i], elem->next);
+        added++;
+    }
+    UNLOCK(&elem->lock);
+    counter_add(&the_list->size, added);
+    return added;
+}
+
+int list_remove_batch(list_t *the_list, const val_t *vals, int n)
+{
+    int removed = 0;
+    node_t *prev = the_list->head;
+    LOCK(&prev->lock);
+    for (int i = 0; i < n; i++) {
+        prev = batch_seek(the_list, prev, vals, i);
+        node_t *elem = prev->next;
+        if (!elem || elem->data != vals[i])
+            continue;
+        /* wait for the threads that may still be reading it */
+        LOCK(&elem->lock);
+        prev->next = elem->next;
+        UNLOCK(&elem->lock);
+        DESTROY_LOCK(&elem->lock);
+        node_free(elem);
+        removed++;
+    }
+    UNLOCK(&prev->lock);
+    counter_add(&the_list->size, -removed);
+    return removed;
+}
+
+int list_contains_batch(list_t *the_list, const val_t *vals, int n)
+{
+    int found = 0;
+    node_t *elem = the_list->head;
+    LOCK(&elem->lock);
+    for (int i = 0; i < n; i++) {
+        elem = batch_seek(the_list, elem, vals, i);
+        found += elem->next && elem->next->data == vals[i];
+    }
+    UNLOCK(&elem->lock);
+    return found;
+}
+#endif
@@ -1,162 +1,498 @@
-#include <limits.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 
-#include "list.h"
-
-struct node {
-    val_t data;
-    struct node *next;
-};
+#include "counter.h"
+#include "harris.h"
+#if defined(LIST_ACCEL)
+#include "accel.h"
+#endif
+#if defined(LIST_BULK)
+#include "dump.h"
+#endif
 
 struct list {
     node_t *head, *tail;
-    uint32_t size;
+    uint64_t id; /* unique among the lists of the process */
+#if defined(LIST_ACCEL)
+    accel_t accel;
+#endif
+    counter_t size; /* updated by every successful update */
 };
 
-/* The following functions handle the low-order mark bit that indicates
- * whether a node is logically deleted (1) or not (0).
- *  - is_marked_ref returns whether it is marked,
- *  - (un)set_marked changes the mark,
- *  - get_(un)marked_ref sets the mark before returning the node.
- */
-static inline bool is_marked_ref(void *i)
+#if defined(LIST_ACCEL)
+static inline void update_begin(list_t *the_list)
 {
-    return (bool) ((uintptr_t) i & 0x1L);
+    accel_update_begin(&the_list->accel);
 }
 
-static inline void *get_unmarked_ref(void *w)
+static inline void update_end(list_t *the_list)
 {
-    return (void *) ((uintptr_t) w & ~0x1L);
+    accel_update_end(&the_list->accel);
 }
+#else
+static inline void update_begin(list_t *the_list) {}
+
+static inline void update_end(list_t *the_list) {}
+#endif
+
+#if defined(LIST_FINGER)
+/* Search fingers: each thread remembers the node before the value of its last
+ * operation and starts the next search from it when it owns a lower value,
+ * which saves most of the traversal when the keys of a thread are clustered.
+ * The node is only used as long as the reclamation scheme guarantees that it
+ * was not freed; if it was removed, the search falls back to the head.
+ */
+static __thread struct {
+    uint64_t list; /* id of the list, as a deleted list may be reallocated */
+    node_t *node;
+    uint64_t token;
+} finger;
 
-static inline void *get_marked_ref(void *w)
+static inline node_t *finger_get(list_t *the_list, val_t val)
 {
-    return (void *) ((uintptr_t) w | 0x1L);
+    uint64_t token = reclaim_token();
+    if (finger.list == the_list->id && token && finger.token == token &&
+        finger.node->data < val)
+        return finger.node;
+    return the_list->head;
 }
 
-/* list_search looks for value val, it
- *  - returns right_node owning val (if present) or its immediately higher
- *    value present in the list (otherwise) and
- *  - sets the left_node to the node owning the value immediately lower than
- *    val.
- * Encountered nodes that are marked as logically deleted are physically removed
- * from the list, yet not garbage collected.
- */
-static node_t *list_search(list_t *set, val_t val, node_t **left_node)
+static inline void finger_set(list_t *the_list, node_t *node)
 {
-    node_t *left_node_next, *right_node;
-    left_node_next = right_node = NULL;
-    while (1) {
-        node_t *t = set->head;
-        node_t *t_next = set->head->next;
-        while (is_marked_ref(t_next) || (t->data < val)) {
-            if (!is_marked_ref(t_next)) {
-                (*left_node) = t;
-                left_node_next = t_next;
-            }
-            t = get_unmarked_ref(t_next);
-            if (t == set->tail)
-                break;
-            t_next = t->next;
-        }
-        right_node = t;
-
-        if (left_node_next == right_node) {
-            if (!is_marked_ref(right_node->next))
-                return right_node;
-        } else {
-            if (CAS_PTR(&((*left_node)->next), left_node_next, right_node) ==
-                left_node_next) {
-                if (!is_marked_ref(right_node->next))
-                    return right_node;
-            }
-        }
-    }
+    finger.list = the_list->id;
+    finger.node = node;
+    finger.token = reclaim_token();
+}
+#else
+static inline node_t *finger_get(list_t *the_list, val_t val)
+{
+    return the_list->head;
 }
 
+static inline void finger_set(list_t *the_list, node_t *node) {}
+#endif
+
 /* return true if there is a node in the list owning value val. */
 bool list_contains(list_t *the_list, val_t val)
 {
-    node_t *iterator = get_unmarked_ref(the_list->head->next);
-    while (iterator != the_list->tail) {
-        if (!is_marked_ref(iterator->next) && iterator->data >= val) {
-            /* either we found it, or found the first larger element */
-            return iterator->data == val;
-        }
-
-        /* always get unmarked pointer */
-        iterator = get_unmarked_ref(iterator->next);
+    reclaim_enter();
+#if defined(LIST_ACCEL)
+    int hit = accel_lookup(&the_list->accel, val);
+    if (hit >= 0) {
+        reclaim_exit();
+        return hit;
     }
-    return false;
-}
-
-static node_t *new_node(val_t val, node_t *next)
-{
-    node_t *node = malloc(sizeof(node_t));
-    node->data = val;
-    node->next = next;
-    return node;
+#endif
+    node_t *start = finger_get(the_list, val);
+    bool found =
+        harris_contains_from(the_list->head, &start, the_list->tail, val);
+    finger_set(the_list, start);
+    reclaim_exit();
+#if defined(LIST_ACCEL)
+    accel_missed(&the_list->accel, the_list);
+#endif
+    return found;
 }
 
 list_t *list_new()
 {
+    static uint64_t lists;
+
     /* allocate list */
-    list_t *the_list = malloc(sizeof(list_t));
+    list_t *the_list;
+    if (posix_memalign((void **) &the_list, 64, sizeof(list_t)) != 0)
+        abort();
 
     /* now need to create the sentinel node */
-    the_list->head = new_node(INT_MIN, NULL);
-    the_list->tail = new_node(INT_MAX, NULL);
+    the_list->head = new_node(VAL_MIN, NULL);
+    the_list->tail = new_node(VAL_MAX, NULL);
     the_list->head->next = the_list->tail;
-    the_list->size = 0;
+    counter_init(&the_list->size, 0);
+    the_list->id = __atomic_add_fetch(&lists, 1, __ATOMIC_RELAXED);
+#if defined(LIST_ACCEL)
+    accel_init(&the_list->accel, 0);
+#endif
     return the_list;
 }
 
+/* free the list and all the nodes still linked in it; the caller must make
+ * sure no other thread is operating on the list.
+ */
 void list_delete(list_t *the_list)
 {
-    /* FIXME: implement the deletion */
+    node_t *elem = the_list->head;
+    while (elem != the_list->tail) {
+        node_t *next = get_unmarked_ref(elem->next);
+        node_free(elem);
+        elem = next;
+    }
+    node_free(the_list->tail);
+#if defined(LIST_ACCEL)
+    accel_destroy(&the_list->accel);
+#endif
+    free(the_list);
+}
+
+int list_size_approx(list_t *the_list)
+{
+    int64_t size = counter_read(&the_list->size);
+    /* a removal may be counted before the insertion of its value */
+    return size > 0 ? size : 0;
 }
 
+/* the values are collected from a snapshot of the list, as by list_range,
+ * so that the size is linearizable. They must be stored: list_range only
+ * tells the nodes it collected from the ones unlinked meanwhile by their
+ * keys, and would count twice those it has no room for. Without range
+ * queries, the size is only exact while no update is under way.
+ */
 int list_size(list_t *the_list)
 {
-    return the_list->size;
+#if defined(LIST_RANGE)
+    int max = list_size_approx(the_list) + 64, n;
+    val_t *buf = malloc(max * sizeof(val_t));
+    while ((n = list_range(the_list, VAL_MIN + 1, VAL_MAX - 1, buf, max)) >
+           max) {
+        max = 2 * n; /* the list grew, take a new snapshot */
+        buf = realloc(buf, max * sizeof(val_t));
+    }
+    free(buf);
+    return n;
+#else
+    return list_size_approx(the_list);
+#endif
 }
 
 bool list_add(list_t *the_list, val_t val)
 {
-    node_t *left = NULL;
-    node_t *new_elem = new_node(val, NULL);
-    while (1) {
-        node_t *right = list_search(the_list, val, &left);
-        if (right != the_list->tail && right->data == val)
-            return false;
-
-        new_elem->next = right;
-        if (CAS_PTR(&(left->next), right, new_elem) == right) {
-            FAI_U32(&(the_list->size));
-            return true;
+    node_t *node;
+    update_begin(the_list);
+    reclaim_enter();
+    node_t *start = finger_get(the_list, val);
+    bool added = harris_insert_from(the_list->head, &start, the_list->tail,
+                                    val, &node);
+    if (added)
+        counter_add(&the_list->size, 1);
+    finger_set(the_list, start);
+    reclaim_exit();
+    update_end(the_list);
+    return added;
+}
+
+bool list_remove(list_t *the_list, val_t val)
+{
+    update_begin(the_list);
+    reclaim_enter();
+    node_t *start = finger_get(the_list, val);
+    bool removed =
+        harris_remove_from(the_list->head, &start, the_list->tail, val);
+    if (removed)
+        counter_add(&the_list->size, -1);
+    finger_set(the_list, start);
+    reclaim_exit();
+    update_end(the_list);
+    return removed;
+}
+
+#if defined(LIST_ACCEL)
+void list_accel(list_t *the_list, uint32_t threshold)
+{
+    the_list->accel.threshold = threshold;
+}
+
+uint64_t list_accel_rebuilds(list_t *the_list)
+{
+    return __atomic_load_n(&the_list->accel.rebuilds, __ATOMIC_RELAXED);
+}
+#endif
+
+#if defined(LIST_MAP)
+bool list_get(list_t *the_list, val_t key, payload_t *payload)
+{
+    reclaim_enter();
+    node_t *start = finger_get(the_list, key);
+    node_t *node =
+        harris_find_from(the_list->head, &start, the_list->tail, key);
+    if (node)
+        *payload = node->payload;
+    finger_set(the_list, start);
+    reclaim_exit();
+    return node != NULL;
+}
+
+/* apply harris_put, keeping the size up to date */
+static int map_put(list_t *the_list,
+                   val_t key,
+                   payload_t payload,
+                   int mode,
+                   payload_t *old)
+{
+    update_begin(the_list);
+    reclaim_enter();
+    int res =
+        harris_put(the_list->head, the_list->tail, key, payload, mode, old);
+    if (res == HARRIS_INSERTED)
+        counter_add(&the_list->size, 1);
+    reclaim_exit();
+    update_end(the_list);
+    return res;
+}
+
+bool list_put(list_t *the_list, val_t key, payload_t payload, payload_t *old)
+{
+    payload_t current;
+    int res = map_put(the_list, key, payload, HARRIS_PUT, &current);
+    if (res == HARRIS_REPLACED && old)
+        *old = current;
+    return res == HARRIS_INSERTED;
+}
+
+bool list_put_if_absent(list_t *the_list,
+                        val_t key,
+                        payload_t payload,
+                        payload_t *current)
+{
+    payload_t found;
+    int res = map_put(the_list, key, payload, HARRIS_PUT_IF_ABSENT, &found);
+    if (res == HARRIS_FOUND && current)
+        *current = found;
+    return res == HARRIS_INSERTED;
+}
+
+bool list_replace(list_t *the_list,
+                  val_t key,
+                  payload_t expected,
+                  payload_t payload)
+{
+    return map_put(the_list, key, payload, HARRIS_REPLACE, &expected) ==
+           HARRIS_REPLACED;
+}
+#endif
+
+#if defined(LIST_MULTI)
+int list_contains_multi(list_t *the_list,
+                        const val_t *vals,
+                        int n,
+                        bool *found)
+{
+    int i = 0, hits = 0;
+    reclaim_enter();
+#if defined(LIST_ACCEL)
+    for (int hit; i < n && (hit = accel_lookup(&the_list->accel, vals[i])) >= 0;
+         i++)
+        hits += found[i] = hit;
+    int missed = i < n;
+#endif
+#if RECLAIM == RECLAIM_HP
+    for (; i < n; i++)
+        hits += found[i] = harris_contains(the_list->head, the_list->tail,
+                                           vals[i]);
+#else
+    for (; i < n; i += HARRIS_MULTI_MAX) {
+        int m = n - i < HARRIS_MULTI_MAX ? n - i : HARRIS_MULTI_MAX;
+        hits += harris_contains_multi(the_list->head, the_list->tail,
+                                      vals + i, m, found + i);
+    }
+#endif
+    reclaim_exit();
+#if defined(LIST_ACCEL)
+    if (missed)
+        accel_missed(&the_list->accel, the_list);
+#endif
+    return hits;
+}
+#endif
+
+#if defined(LIST_BULK)
+/* link n nodes, allocated in key order, between the sentinels of an empty
+ * list; payloads may be NULL.
+ */
+static list_t *build(const val_t *keys, const uint64_t *payloads, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        if (keys[i] == VAL_MIN || keys[i] == VAL_MAX ||
+            (i > 0 && keys[i] <= keys[i - 1]))
+            return NULL;
+    if (n > UINT32_MAX)
+        return NULL;
+
+    list_t *the_list = list_new();
+    node_t *prev = the_list->head;
+#if defined(LIST_RANGE)
+    /* the nodes belong to every snapshot taken once the list is published;
+     * left unset, they would be stamped by the first range query to reach
+     * them, with a time past its own snapshot.
+     */
+    uint64_t now = __atomic_load_n(&snap_clock, __ATOMIC_SEQ_CST);
+#endif
+    for (size_t i = 0; i < n; i++) {
+        node_t *node = init_node(node_alloc_sequential(sizeof(node_t)),
+                                 keys[i], the_list->tail);
+#if defined(LIST_MAP)
+        if (payloads)
+            node->payload = payloads[i];
+#endif
+#if defined(LIST_RANGE)
+        node->ins_ts = now;
+#endif
+        prev->next = node;
+        prev = node;
+    }
+    counter_init(&the_list->size, n);
+    /* publish the nodes along with the list */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return the_list;
+}
+
+list_t *list_build_from_sorted(const val_t *keys, size_t n)
+{
+    return build(keys, NULL, n);
+}
+
+int list_save(list_t *the_list, const char *path)
+{
+    size_t n = 0, capacity = list_size_approx(the_list) + 1;
+    val_t *keys = malloc(capacity * sizeof(val_t));
+    uint64_t *payloads = malloc(capacity * sizeof(uint64_t));
+    node_t *node = get_unmarked_ref(the_list->head->next);
+    for (; node != the_list->tail; node = get_unmarked_ref(node->next)) {
+        if (is_marked_ref(node->next)) /* removed, or replaced by a copy */
+            continue;
+        if (n == capacity) {
+            capacity *= 2;
+            keys = realloc(keys, capacity * sizeof(val_t));
+            payloads = realloc(payloads, capacity * sizeof(uint64_t));
         }
+        keys[n] = node->data;
+#if defined(LIST_MAP)
+        payloads[n] = node->payload;
+#else
+        payloads[n] = 0;
+#endif
+        n++;
     }
+    int ret = dump_write(path, keys, payloads, n);
+    free(keys);
+    free(payloads);
+    return ret;
 }
 
-/* The deletion is logical and consists of setting the node mark bit to 1. */
-bool list_remove(list_t *the_list, val_t val)
+list_t *list_load(const char *path)
+{
+    dump_t d;
+    if (dump_open(&d, path) != 0)
+        return NULL;
+    list_t *the_list = build(d.keys, d.payloads, d.count);
+    dump_close(&d);
+    if (!the_list)
+        fprintf(stderr, "%s: the keys are not sorted\n", path);
+    return the_list;
+}
+
+/* Each value is removed as by list_remove, so the nodes are retired through
+ * the reclamation scheme and concurrent operations are safe. The first node
+ * of the list is removed until there is none, which takes a single step of
+ * the search each time.
+ */
+int list_clear(list_t *the_list)
 {
     node_t *left = NULL;
+    int removed = 0;
+    update_begin(the_list);
+    reclaim_enter();
     while (1) {
-        node_t *right = list_search(the_list, val, &left);
-        /* check if we found our node */
-        if ((right == the_list->tail) || (right->data != val))
-            return false;
-
-        node_t *right_succ = right->next;
-        if (!is_marked_ref(right_succ)) {
-            if (CAS_PTR(&(right->next), right_succ,
-                        get_marked_ref(right_succ)) == right_succ) {
-                FAD_U32(&(the_list->size));
-                return true;
-            }
+        node_t *first =
+            harris_search(the_list->head, the_list->tail, VAL_MIN + 1, &left);
+        if (first == the_list->tail)
+            break;
+        node_t *start = the_list->head;
+        if (harris_remove_from(the_list->head, &start, the_list->tail,
+                               first->data)) {
+            counter_add(&the_list->size, -1);
+            removed++;
         }
     }
+    reclaim_exit();
+    update_end(the_list);
+    return removed;
+}
+#endif
+
+#if defined(LIST_RANGE)
+int list_range(list_t *the_list, val_t lo, val_t hi, val_t *buf, int max)
+{
+    reclaim_enter();
+    uint64_t ts = snap_begin();
+    int n = harris_collect(the_list->head, the_list->tail, lo, hi, ts, buf, max);
+    n = snap_end(ts, lo, hi, buf, n, max);
+    reclaim_exit();
+    return n;
+}
+#endif
+
+#if defined(LIST_BATCH)
+/* The values are handled in a single pass: each operation starts from the
+ * node before the previous value. If the values are not sorted, the pass
+ * starts over from the head.
+ */
+static inline void batch_next(list_t *the_list,
+                              const val_t *vals,
+                              int i,
+                              node_t **start)
+{
+    if (i > 0 && vals[i] < vals[i - 1])
+        *start = the_list->head;
+    else
+        reclaim_hold(HARRIS_HP_START, *start);
+}
+
+int list_add_batch(list_t *the_list, const val_t *vals, int n)
+{
+    node_t *start = the_list->head, *node;
+    int added = 0;
+    update_begin(the_list);
+    reclaim_enter();
+    for (int i = 0; i < n; i++) {
+        batch_next(the_list, vals, i, &start);
+        added += harris_insert_from(the_list->head, &start, the_list->tail,
+                                    vals[i], &node);
+    }
+    counter_add(&the_list->size, added);
+    reclaim_exit();
+    update_end(the_list);
+    return added;
+}
+
+int list_remove_batch(list_t *the_list, const val_t *vals, int n)
+{
+    node_t *start = the_list->head;
+    int removed = 0;
+    update_begin(the_list);
+    reclaim_enter();
+    for (int i = 0; i < n; i++) {
+        batch_next(the_list, vals, i, &start);
+        removed += harris_remove_from(the_list->head, &start, the_list->tail,
+                                      vals[i]);
+    }
+    counter_add(&the_list->size, -removed);
+    reclaim_exit();
+    update_end(the_list);
+    return removed;
+}
+
+int list_contains_batch(list_t *the_list, const val_t *vals, int n)
+{
+    node_t *start = the_list->head;
+    int found = 0;
+    reclaim_enter();
+    for (int i = 0; i < n; i++) {
+        batch_next(the_list, vals, i, &start);
+        found += harris_contains_from(the_list->head, &start, the_list->tail,
+                                      vals[i]);
+    }
+    reclaim_exit();
+    return found;
 }
+#endif
@@ -1,13 +1,30 @@
 #include <getopt.h>
-#include <limits.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
 #include <pthread.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/time.h>
+#include <sys/wait.h>
 #include <time.h>
+#include <unistd.h>
 
+#include "alloc.h"
+#include "dist.h"
+#include "histogram.h"
 #include "list.h"
+#include "perf.h"
+#include "stats.h"
+#include "topology.h"
+#include "trace.h"
+#if defined(RECLAIM)
+#include "reclaim.h"
+#endif
 #include "utils.h"
 
 #define XSTR(s) STR(s)
@@ -26,15 +43,66 @@
 /* the maximum value the key stored in the list can take; defines key range */
 #define DEFAULT_RANGE 2048
 
+/* default percentage of range scans, taken out of the reads, and the number
+ * of keys each scan covers
+ */
+#define DEFAULT_SCANS 0
+#define DEFAULT_SCAN_WIDTH 64
+
+/* default number of keys per operation; above 1, each operation is a batch
+ * of sorted keys handled by the list_*_batch functions
+ */
+#define DEFAULT_BATCH 1
+
+/* default number of lookups interleaved by list_contains_multi; at 1, the
+ * lookups go through list_contains one at a time
+ */
+#define DEFAULT_GROUP 1
+
+/* kinds of timed operations, each split into successful and failed calls */
+#define LAT_CONTAINS 0
+#define LAT_ADD 1
+#define LAT_REMOVE 2
+#define LAT_KINDS 3
+
 static uint32_t finds;
-static uint32_t max_key;
+static dist_t dist;
+static uint32_t scans;
+static uint32_t scan_width;
+static uint32_t batch;
+static uint32_t group;
+/* drive the map operations instead of the set operations */
+static bool map;
+/* main calls list_size during the run and checks the counts */
+static bool check_size;
+static uint32_t range;
+/* added to the keys of the distribution, which are within [0, range) */
+static val_t key_offset;
+static bool latency;
+static int pin;
+/* stale lookups per rebuild of the read accelerator, 0 if disabled */
+static uint32_t accel;
+/* the list was filled by main, in bulk or from a dump, rather than by the
+ * threads
+ */
+static bool prefilled;
 
-/* used to signal the threads when to stop */
-static ALIGNED(64) uint8_t running[64];
+/* trace being replayed instead of the synthetic workload, if any */
+static trace_t *trace;
+/* record the synthetic workload into the trace buffer of each thread */
+static bool recording;
+
+/* used to signal the threads when to stop; shared with the processes of -P */
+static uint8_t *running;
 
 /* per-thread seeds for the custom random function */
 __thread uint64_t *seeds;
 
+#if defined(STATS)
+/* contention statistics of the calling thread */
+__thread stats_t stats_self;
+#endif
+
 static list_t *the_list;
 
 /* a simple barrier implementation, used to make sure all threads start the
@@ -47,10 +115,23 @@ typedef struct barrier {
     int crossing;
 } barrier_t;
 
+/* the barrier may be crossed by the threads of several processes, if it is
+ * in shared memory
+ */
 void barrier_init(barrier_t *b, int n)
 {
-    pthread_cond_init(&b->complete, NULL);
-    pthread_mutex_init(&b->mutex, NULL);
+    pthread_condattr_t cattr;
+    pthread_condattr_init(&cattr);
+    pthread_condattr_setpshared(&cattr, PTHREAD_PROCESS_SHARED);
+    pthread_cond_init(&b->complete, &cattr);
+    pthread_condattr_destroy(&cattr);
+
+    pthread_mutexattr_t mattr;
+    pthread_mutexattr_init(&mattr);
+    pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(&b->mutex, &mattr);
+    pthread_mutexattr_destroy(&mattr);
+
     b->count = n;
     b->crossing = 0;
 }
@@ -71,15 +152,169 @@ void barrier_cross(barrier_t *b)
 /* data structure through which we send parameters to and get results from the
  * worker threads.
  */
-typedef ALIGNED(64) struct thread_data {
+typedef struct thread_data {
     barrier_t *barrier;  /* pointer to the global barrier */
     unsigned long n_ops; /* operations each thread performs */
     uint64_t n_add; /* elements each thread should add at beginning of exec */
     unsigned long n_insert; /* number of inserts a thread performs */
     unsigned long n_remove; /* number of removes a thread performs */
     unsigned long n_search; /* number of searches a thread performs */
+    unsigned long n_scan;   /* number of range scans a thread performs */
+    hist_t *lat; /* latencies in ticks, [2 * kind + failed], if enabled */
     int id; /* the id of the thread (used for thread placement on cores) */
-} thread_data_t;
+    cpu_info_t *cpu; /* cpu the thread is pinned to, NULL if not pinned */
+    trace_buf_t rec; /* operations recorded by the thread */
+    perf_counters_t perf; /* counters of the measured phase, if enabled */
+#if defined(STATS)
+    stats_t stats; /* contention statistics of the measured phase */
+#endif
+} ALIGNED(64) thread_data_t;
+
+/* each thread writes its data on cache lines of its own */
+STATIC_ASSERT(sizeof(thread_data_t) % 64 == 0,
+              "thread_data_t must be padded to a cache line");
+
+#if defined(LIST_MAP)
+/* Payloads of the map workload: the key, scrambled, plus a version that
+ * list_replace bumps. A payload read under another key, or half written,
+ * is caught by map_check.
+ */
+#define MAP_MIX UINT64_C(0x9e3779b97f4a7c15)
+
+static inline payload_t map_payload(val_t key)
+{
+    return (uint64_t) key * MAP_MIX;
+}
+
+static inline void map_check(val_t key, payload_t payload)
+{
+    if (payload - map_payload(key) >= (UINT64_C(1) << 32)) {
+        fprintf(stderr, "Wrong payload %#" PRIx64 " for key %" PRId64 "\n",
+                payload, key);
+        abort();
+    }
+}
+#endif
+
+/* insert key as part of the prefill */
+static inline bool prefill_add(val_t key)
+{
+#if defined(LIST_MAP)
+    if (map)
+        return list_put_if_absent(the_list, key, map_payload(key), NULL);
+#endif
+    return list_add(the_list, key);
+}
+
+#if defined(LIST_BULK)
+static int compare_val(const void *a, const void *b)
+{
+    val_t x = *(const val_t *) a, y = *(const val_t *) b;
+    return (x > y) - (x < y);
+}
+
+/* draw n distinct keys of the uniform distribution, in ascending order; n
+ * must not exceed the key range
+ */
+static val_t *prefill_keys(size_t n)
+{
+    val_t *keys = malloc(n * sizeof(val_t));
+    size_t count = 0;
+    /* replace the duplicates until there are none */
+    while (count < n) {
+        for (size_t i = count; i < n; i++)
+            keys[i] = key_offset + dist_uniform(&dist);
+        qsort(keys, n, sizeof(val_t), compare_val);
+        count = n > 0;
+        for (size_t i = 1; i < n; i++)
+            if (keys[i] != keys[count - 1])
+                keys[count++] = keys[i];
+    }
+    return keys;
+}
+#endif
+
+#if defined(LIST_BATCH)
+/* fill keys with a sorted batch of keys of the distribution */
+static void batch_keys(val_t *keys, uint32_t *cursor, bool insert)
+{
+    for (int i = 0; i < batch; i++) {
+        val_t v = key_offset + dist_next(&dist, cursor, insert);
+        int j = i;
+        for (; j > 0 && keys[j - 1] > v; j--)
+            keys[j] = keys[j - 1];
+        keys[j] = v;
+    }
+}
+#endif
+
+/* record the latency of a call started at tick t0 */
+static inline void lat_record(thread_data_t *d, int kind, bool ok, ticks t0)
+{
+    if (latency)
+        hist_record(&d->lat[2 * kind + !ok], getticks() - t0);
+}
+
+/* replay stream d->id of the trace: fill the list with its prefill records,
+ * then run the others once, or until the end of the experiment
+ */
+static void replay(thread_data_t *d)
+{
+    const uint64_t *recs = trace_records(trace, d->id);
+    uint64_t prefill = trace->streams[d->id].prefill;
+    uint64_t count = trace->streams[d->id].count;
+#if defined(LIST_RANGE)
+    uint32_t width = trace->header->scan_width;
+    val_t *scan_buf = malloc(width * sizeof(val_t));
+#endif
+
+    /* a list may refuse some keys (e.g. those of its sentinels) */
+    d->n_add = 0;
+    for (uint64_t i = 0; i < prefill; i++)
+        d->n_add += list_add(the_list, trace_key(recs[i]));
+
+    barrier_cross(d->barrier);
+#if defined(STATS)
+    memset(&stats_self, 0, sizeof(stats_t));
+#endif
+    for (uint64_t i = prefill; i < count && *running; i++) {
+        uint64_t rec = recs[i];
+        val_t the_value = trace_key(rec);
+        ticks t0 = latency ? getticks() : 0;
+        switch (trace_op(rec)) {
+        case TRACE_CONTAINS: {
+            bool ok = list_contains(the_list, the_value);
+            lat_record(d, LAT_CONTAINS, ok, t0);
+            break;
+        }
+        case TRACE_ADD: {
+            bool ok = list_add(the_list, the_value);
+            lat_record(d, LAT_ADD, ok, t0);
+            d->n_insert += ok;
+            break;
+        }
+        case TRACE_REMOVE: {
+            bool ok = list_remove(the_list, the_value);
+            lat_record(d, LAT_REMOVE, ok, t0);
+            d->n_remove += ok;
+            break;
+        }
+        default:
+#if defined(LIST_RANGE)
+            list_range(the_list, the_value, the_value + width - 1, scan_buf,
+                       width);
+#endif
+            d->n_scan++;
+        }
+        d->n_ops++;
+    }
+#if defined(STATS)
+    d->stats = stats_self;
+#endif
+#if defined(LIST_RANGE)
+    free(scan_buf);
+#endif
+}
 
 void *test(void *data)
 {
@@ -90,51 +325,505 @@ void *test(void *data)
      * we can simply do random() & 256
      */
     uint32_t read_thresh = 256 * finds / 100;
+    uint32_t scan_thresh = 256 * scans / 100;
+    /* pin before the prefill, so that the nodes this thread allocates are
+     * first touched, and thus placed, on its own NUMA node
+     */
+    if (d->cpu && topology_pin(d->cpu->cpu) != 0) {
+        fprintf(stderr, "Cannot pin thread %d to cpu %d\n", d->id, d->cpu->cpu);
+        exit(1);
+    }
     seeds = seed_rand(); /* the custom random number generator */
-    uint32_t rand_max = max_key;
+    if (latency) {
+        d->lat = malloc(2 * LAT_KINDS * sizeof(hist_t));
+        for (int i = 0; i < 2 * LAT_KINDS; i++)
+            hist_init(&d->lat[i]);
+    }
+    /* the counters are enabled by main once all threads are ready */
+    if (perf_events() && perf_open(&d->perf) != 0)
+        exit(1);
+    if (trace) {
+        replay(d);
+        return NULL;
+    }
     val_t the_value;
     int last = -1;
+#if defined(LIST_RANGE)
+    val_t *scan_buf = malloc(scan_width * sizeof(val_t));
+#endif
+#if defined(LIST_BATCH)
+    val_t *batch_buf = malloc(batch * sizeof(val_t));
+#endif
+#if defined(LIST_MULTI)
+    val_t *group_buf = malloc(group * sizeof(val_t));
+    bool *group_found = malloc(group * sizeof(bool));
+#endif
 
     /* before starting the test, we insert a number of elements in the data
      * structure.
      * we do this at each thread to avoid the situation where the entire data
      * structure resides in the same memory node.
      */
-    for (int i = 0; i < d->n_add; ++i) {
-        the_value =
-            (val_t) my_random(&seeds[0], &seeds[1], &seeds[2]) & rand_max;
+    for (int i = 0; i < d->n_add && !prefilled; ++i) {
+        the_value = key_offset + dist_uniform(&dist);
         /* we make sure the insert was effective (as opposed to just updating an
          * existing entry).
          */
-        if (list_add(the_list, the_value) == 0)
+        if (!prefill_add(the_value))
             i--;
+        else if (recording)
+            trace_push(&d->rec, TRACE_ADD, the_value);
     }
+    d->rec.prefill = d->rec.count;
+
+    /* each thread starts from a different position */
+    uint32_t cursor = dist_uniform(&dist);
 
     /* Wait on barrier */
     barrier_cross(d->barrier);
+#if defined(STATS)
+    /* leave the prefill out of the statistics */
+    memset(&stats_self, 0, sizeof(stats_t));
+#endif
     while (*running) { /* start the test */
-        /* generate value (node that rand_max is expected to be power of 2) */
-        the_value = my_random(&seeds[0], &seeds[1], &seeds[2]) & rand_max;
-        /* generate the operation */
+        /* generate the operation, then its key */
         uint32_t op = my_random(&seeds[0], &seeds[1], &seeds[2]) & 0xff;
-        if (op < read_thresh) { /* do a find operation */
-            list_contains(the_list, the_value);
+        bool insert = op >= read_thresh && last == -1;
+        the_value = key_offset + dist_next(&dist, &cursor, insert);
+        if (recording)
+            trace_push(&d->rec,
+                       op < scan_thresh   ? TRACE_SCAN
+                       : op < read_thresh ? TRACE_CONTAINS
+                       : insert           ? TRACE_ADD
+                                          : TRACE_REMOVE,
+                       the_value);
+        ticks t0 = latency ? getticks() : 0;
+        if (op < scan_thresh) { /* do a range scan */
+#if defined(LIST_RANGE)
+            list_range(the_list, the_value, the_value + scan_width - 1,
+                       scan_buf, scan_width);
+#endif
+            d->n_scan++;
+        } else if (batch > 1) { /* do a batch of operations of one kind */
+#if defined(LIST_BATCH)
+            batch_keys(batch_buf, &cursor, insert);
+            t0 = latency ? getticks() : 0;
+            if (op < read_thresh) {
+                int n = list_contains_batch(the_list, batch_buf, batch);
+                lat_record(d, LAT_CONTAINS, n, t0);
+            } else if (last == -1) {
+                int n = list_add_batch(the_list, batch_buf, batch);
+                lat_record(d, LAT_ADD, n, t0);
+                d->n_insert += n;
+                if (n)
+                    last = 1;
+            } else {
+                int n = list_remove_batch(the_list, batch_buf, batch);
+                lat_record(d, LAT_REMOVE, n, t0);
+                d->n_remove += n;
+                if (n)
+                    last = -1;
+            }
+#endif
+            d->n_ops += batch - 1;
+        } else if (map) { /* the same operations, on the payloads */
+#if defined(LIST_MAP)
+            payload_t p;
+            bool ok;
+            if (op < read_thresh) {
+                ok = list_get(the_list, the_value, &p);
+                lat_record(d, LAT_CONTAINS, ok, t0);
+                if (ok)
+                    map_check(the_value, p);
+                /* every other hit bumps the version of the payload */
+                if (ok && (op & 1))
+                    list_replace(the_list, the_value, p, p + 1);
+            } else if (last == -1) {
+                /* list_put returns the replaced payload, if any */
+                ok = op & 1 ? list_put(the_list, the_value,
+                                       map_payload(the_value), &p)
+                            : list_put_if_absent(the_list, the_value,
+                                                 map_payload(the_value), &p);
+                lat_record(d, LAT_ADD, ok, t0);
+                if (ok) {
+                    d->n_insert++;
+                    last = 1;
+                } else {
+                    map_check(the_value, p);
+                }
+            } else {
+                ok = list_remove(the_list, the_value);
+                lat_record(d, LAT_REMOVE, ok, t0);
+                if (ok) {
+                    d->n_remove++;
+                    last = -1;
+                }
+            }
+#endif
+        } else if (op < read_thresh && group > 1) { /* interleaved finds */
+#if defined(LIST_MULTI)
+            group_buf[0] = the_value;
+            for (int i = 1; i < group; i++)
+                group_buf[i] = key_offset + dist_next(&dist, &cursor, false);
+            t0 = latency ? getticks() : 0;
+            int n = list_contains_multi(the_list, group_buf, group, group_found);
+            lat_record(d, LAT_CONTAINS, n, t0);
+#endif
+            d->n_ops += group - 1;
+        } else if (op < read_thresh) { /* do a find operation */
+            bool ok = list_contains(the_list, the_value);
+            lat_record(d, LAT_CONTAINS, ok, t0);
         } else if (last == -1) { /* do a write operation */
-            if (list_add(the_list, the_value)) {
+            bool ok = list_add(the_list, the_value);
+            lat_record(d, LAT_ADD, ok, t0);
+            if (ok) {
                 d->n_insert++;
                 last = 1;
             }
         } else {
-            if (list_remove(the_list, the_value)) { /* do a delete operation */
+            bool ok = list_remove(the_list, the_value);
+            lat_record(d, LAT_REMOVE, ok, t0);
+            if (ok) { /* do a delete operation */
                 d->n_remove++;
                 last = -1;
             }
         }
         d->n_ops++;
     }
+#if defined(STATS)
+    d->stats = stats_self;
+#endif
+#if defined(LIST_RANGE)
+    free(scan_buf);
+#endif
+#if defined(LIST_BATCH)
+    free(batch_buf);
+#endif
+#if defined(LIST_MULTI)
+    free(group_buf);
+    free(group_found);
+#endif
     return NULL;
 }
 
+/* output formats of the results */
+#define FORMAT_TEXT 0
+#define FORMAT_JSON 1
+#define FORMAT_CSV 2
+
+static const char *lat_names[LAT_KINDS] = {"contains", "add", "remove"};
+static const double lat_percentiles[] = {50, 90, 99, 99.9};
+#define LAT_PERCENTILES (sizeof(lat_percentiles) / sizeof(double))
+
+/* results of the experiment as a whole */
+typedef struct summary {
+    const char *list; /* name of the list variant */
+    int n_threads;
+    int duration;              /* measured, in ms */
+    unsigned long operations;  /* by all threads */
+    long expected, actual;     /* list sizes */
+    double ticks_per_ns;
+    uint64_t perf[PERF_MAX_EVENTS]; /* counts of all threads */
+#if defined(LIST_ACCEL)
+    uint64_t rebuilds; /* of the read accelerator */
+#endif
+#if defined(STATS)
+    stats_t stats; /* merged over the threads */
+#endif
+    alloc_stats_t as;
+#if defined(RECLAIM)
+    reclaim_stats_t rs;
+#endif
+    long rss; /* peak, in KB */
+    unsigned long size_checks, size_wrong; /* list_size calls of -C */
+} summary_t;
+
+static const char *dist_spec = "uniform";
+static const char *pin_names[] = {"none", "compact", "scatter", "list"};
+
+/* merge the latency histograms of kind i (2 * kind + failed) of the threads */
+static void lat_merge(hist_t *h, thread_data_t *data, int n_threads, int i)
+{
+    hist_init(h);
+    for (int t = 0; t < n_threads; t++)
+        hist_merge(h, &data[t].lat[i]);
+}
+
+/* print the percentiles of the merged latency histograms, converted to
+ * nanoseconds at ticks_per_ns
+ */
+static void print_latency(thread_data_t *data, int n_threads,
+                          double ticks_per_ns)
+{
+    hist_t *h = malloc(sizeof(hist_t));
+
+    printf("Latency (ns)    :      count      p50      p90      p99    p99.9"
+           "      max\n");
+    for (int i = 0; i < 2 * LAT_KINDS; i++) {
+        lat_merge(h, data, n_threads, i);
+        if (!h->count)
+            continue;
+        printf("  %-8s %-4s : %10" PRIu64, lat_names[i / 2],
+               i % 2 ? "fail" : "ok", h->count);
+        for (int j = 0; j < LAT_PERCENTILES; j++)
+            printf(" %8.0f", hist_percentile(h, lat_percentiles[j]) / ticks_per_ns);
+        printf(" %8.0f\n", h->max / ticks_per_ns);
+    }
+    free(h);
+}
+
+static void report_text(thread_data_t *data, const summary_t *sum)
+{
+    for (int i = 0; i < sum->n_threads; i++) {
+        printf("Thread %d\n", i);
+        if (data[i].cpu)
+            printf("  cpu        : %d (socket %d, core %d, node %d)\n",
+                   data[i].cpu->cpu, data[i].cpu->socket, data[i].cpu->core,
+                   data[i].cpu->node);
+        printf("  #operations   : %lu\n", data[i].n_ops);
+        printf("  #inserts   : %lu\n", data[i].n_insert);
+        printf("  #removes   : %lu\n", data[i].n_remove);
+        if (scans || trace)
+            printf("  #scans     : %lu\n", data[i].n_scan);
+    }
+
+    printf("Placement     : %s\n", pin_names[pin]);
+    printf("Duration      : %d (ms)\n", sum->duration);
+    printf("#txs     : %lu (%f / s)\n", sum->operations,
+           sum->operations * 1000.0 / sum->duration);
+    printf("Expected size: %ld Actual size: %ld\n", sum->expected,
+           sum->actual);
+
+    if (latency)
+        print_latency(data, sum->n_threads, sum->ticks_per_ns);
+
+    if (perf_events()) {
+        printf("Perf events     :                total       per op\n");
+        for (int i = 0; i < perf_events(); i++)
+            printf("  %-22s : %14" PRIu64 " %12.2f\n", perf_event_name(i),
+                   sum->perf[i], (double) sum->perf[i] / sum->operations);
+    }
+
+#if defined(LIST_ACCEL)
+    if (accel)
+        printf("#snapshot rebuilds : %" PRIu64 " (every %u stale lookups)\n",
+               sum->rebuilds, accel);
+#endif
+    if (check_size)
+        printf("#size checks : %lu (%lu out of bounds)\n", sum->size_checks,
+               sum->size_wrong);
+    printf("#allocs : %" PRIu64 " #frees : %" PRIu64 " #slabs : %" PRIu64
+           " bytes/node : %zu (%zu used)\n",
+           sum->as.allocs, sum->as.frees, sum->as.slabs, sum->as.slot,
+           sum->as.size);
+#if defined(RECLAIM)
+    printf("#retired : %" PRIu64 " #freed : %" PRIu64 " #unreclaimed : %" PRIu64
+           " (peak %" PRIu64 ")\n",
+           sum->rs.retired, sum->rs.freed, sum->rs.pending, sum->rs.peak);
+#endif
+#if defined(STATS)
+    printf("#cas failures : %" PRIu64 " #search retries : %" PRIu64
+           " #marked skipped : %" PRIu64 " #marked snipped : %" PRIu64 "\n",
+           sum->stats.cas_failures, sum->stats.search_retries,
+           sum->stats.marked_skipped, sum->stats.marked_snipped);
+    printf("#traversed : %" PRIu64 " (%.2f / op) #lock acquires : %" PRIu64
+           " #lock spins : %" PRIu64 "\n",
+           sum->stats.traversed, (double) sum->stats.traversed / sum->operations,
+           sum->stats.lock_acquires, sum->stats.lock_spins);
+    if (accel)
+        printf("#snapshot hits : %" PRIu64 " #snapshot stale : %" PRIu64 "\n",
+               sum->stats.snap_hits, sum->stats.snap_stale);
+#endif
+    printf("Peak RSS : %ld (KB)\n", sum->rss);
+}
+
+static void report_json(thread_data_t *data, const summary_t *sum)
+{
+    printf("{\n  \"config\": {\"list\": \"%s\", \"threads\": %d, "
+           "\"range\": %u, \"key_offset\": %" PRId64 ", "
+           "\"update_pct\": %u, \"scan_pct\": %u, \"scan_width\": %u, "
+           "\"batch\": %u, \"group\": %u, \"map\": %s, \"dist\": \"%s\", "
+           "\"pin\": \"%s\", \"trace\": %s},\n",
+           sum->list, sum->n_threads, range, key_offset, 100 - finds, scans,
+           scan_width, batch, group, map ? "true" : "false", dist_spec,
+           pin_names[pin], trace ? "true" : "false");
+
+    printf("  \"threads\": [\n");
+    for (int i = 0; i < sum->n_threads; i++) {
+        printf("    {\"id\": %d, \"cpu\": %d, \"operations\": %lu, "
+               "\"inserts\": %lu, \"removes\": %lu, \"scans\": %lu}%s\n",
+               i, data[i].cpu ? data[i].cpu->cpu : -1, data[i].n_ops,
+               data[i].n_insert, data[i].n_remove, data[i].n_scan,
+               i + 1 < sum->n_threads ? "," : "");
+    }
+    printf("  ],\n");
+
+    printf("  \"duration_ms\": %d,\n  \"operations\": %lu,\n"
+           "  \"throughput\": %f,\n",
+           sum->duration, sum->operations,
+           sum->operations * 1000.0 / sum->duration);
+    printf("  \"expected_size\": %ld,\n  \"actual_size\": %ld,\n",
+           sum->expected, sum->actual);
+
+    if (latency) {
+        hist_t *h = malloc(sizeof(hist_t));
+        printf("  \"latency_ns\": {");
+        for (int i = 0; i < 2 * LAT_KINDS; i++) {
+            lat_merge(h, data, sum->n_threads, i);
+            printf("%s\n    \"%s_%s\": {\"count\": %" PRIu64, i ? "," : "",
+                   lat_names[i / 2], i % 2 ? "fail" : "ok", h->count);
+            for (int j = 0; j < LAT_PERCENTILES; j++)
+                printf(", \"p%g\": %.0f", lat_percentiles[j],
+                       hist_percentile(h, lat_percentiles[j]) /
+                           sum->ticks_per_ns);
+            printf(", \"max\": %.0f}", h->max / sum->ticks_per_ns);
+        }
+        printf("\n  },\n");
+        free(h);
+    }
+
+    if (perf_events()) {
+        printf("  \"perf\": {");
+        for (int i = 0; i < perf_events(); i++)
+            printf("%s\n    \"%s\": {\"total\": %" PRIu64
+                   ", \"per_op\": %.2f}",
+                   i ? "," : "", perf_event_name(i), sum->perf[i],
+                   (double) sum->perf[i] / sum->operations);
+        printf("\n  },\n");
+    }
+
+#if defined(LIST_ACCEL)
+    if (accel)
+        printf("  \"accel\": {\"threshold\": %u, \"rebuilds\": %" PRIu64 "},\n",
+               accel, sum->rebuilds);
+#endif
+    if (check_size)
+        printf("  \"size_checks\": {\"checks\": %lu, \"out_of_bounds\": %lu},\n",
+               sum->size_checks, sum->size_wrong);
+    printf("  \"alloc\": {\"allocs\": %" PRIu64 ", \"frees\": %" PRIu64
+           ", \"slabs\": %" PRIu64 ", \"node_bytes\": %zu, "
+           "\"node_used\": %zu},\n",
+           sum->as.allocs, sum->as.frees, sum->as.slabs, sum->as.slot,
+           sum->as.size);
+#if defined(RECLAIM)
+    printf("  \"reclaim\": {\"retired\": %" PRIu64 ", \"freed\": %" PRIu64
+           ", \"unreclaimed\": %" PRIu64 ", \"peak\": %" PRIu64 "},\n",
+           sum->rs.retired, sum->rs.freed, sum->rs.pending, sum->rs.peak);
+#endif
+#if defined(STATS)
+    printf("  \"stats\": {\"cas_failures\": %" PRIu64
+           ", \"search_retries\": %" PRIu64 ", \"marked_skipped\": %" PRIu64
+           ", \"marked_snipped\": %" PRIu64 ", \"traversed\": %" PRIu64
+           ", \"lock_acquires\": %" PRIu64 ", \"lock_spins\": %" PRIu64
+           ", \"snap_hits\": %" PRIu64 ", \"snap_stale\": %" PRIu64 "},\n",
+           sum->stats.cas_failures, sum->stats.search_retries,
+           sum->stats.marked_skipped, sum->stats.marked_snipped,
+           sum->stats.traversed, sum->stats.lock_acquires,
+           sum->stats.lock_spins, sum->stats.snap_hits, sum->stats.snap_stale);
+#endif
+    printf("  \"peak_rss_kb\": %ld\n}\n", sum->rss);
+}
+
+/* one row per thread, then a row for the whole run with thread "all" */
+static void report_csv(thread_data_t *data, const summary_t *sum)
+{
+    printf("list,threads,range,key_offset,update_pct,scan_pct,scan_width,"
+           "batch,group,map,dist,pin,thread,cpu,operations,inserts,removes,scans,"
+           "duration_ms,throughput,expected_size,actual_size\n");
+    unsigned long inserts = 0, removes = 0, n_scans = 0;
+    for (int i = 0; i <= sum->n_threads; i++) {
+        printf("%s,%d,%u,%" PRId64 ",%u,%u,%u,%u,%u,%d,%s,%s,", sum->list,
+               sum->n_threads, range, key_offset, 100 - finds, scans,
+               scan_width, batch, group, map, dist_spec, pin_names[pin]);
+        if (i < sum->n_threads) {
+            printf("%d,%d,%lu,%lu,%lu,%lu,%d,%f,,\n", i,
+                   data[i].cpu ? data[i].cpu->cpu : -1, data[i].n_ops,
+                   data[i].n_insert, data[i].n_remove, data[i].n_scan,
+                   sum->duration, data[i].n_ops * 1000.0 / sum->duration);
+            inserts += data[i].n_insert;
+            removes += data[i].n_remove;
+            n_scans += data[i].n_scan;
+        } else {
+            printf("all,-1,%lu,%lu,%lu,%lu,%d,%f,%ld,%ld\n", sum->operations,
+                   inserts, removes, n_scans, sum->duration,
+                   sum->operations * 1000.0 / sum->duration, sum->expected,
+                   sum->actual);
+        }
+    }
+}
+
+/* out/lists runs several variants in the same process, so the peak RSS of
+ * a run is measured from its start: the high-water mark of the process is
+ * reset (Linux, see clear_refs in proc(5)) and read back from VmHWM, as
+ * ru_maxrss also keeps the peak of the threads that have exited.
+ */
+static void rss_reset(void)
+{
+#if defined(__linux__)
+    FILE *f = fopen("/proc/self/clear_refs", "w");
+    if (f) {
+        fputs("5", f);
+        fclose(f);
+    }
+#endif
+}
+
+/* peak RSS since rss_reset, in KB */
+static long rss_peak(void)
+{
+    long kb = -1;
+#if defined(__linux__)
+    char line[128];
+    FILE *f = fopen("/proc/self/status", "r");
+    if (f) {
+        while (kb < 0 && fgets(line, sizeof(line), f))
+            if (sscanf(line, "VmHWM: %ld", &kb) != 1)
+                kb = -1;
+        fclose(f);
+    }
+#endif
+    if (kb < 0) {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        kb = usage.ru_maxrss;
+#if defined(__APPLE__)
+        kb /= 1024; /* ru_maxrss is in bytes on OS X */
+#endif
+    }
+    return kb;
+}
+
+/* call list_size until timeout has elapsed. Every thread adds a value
+ * before it removes one, so it has removed as many values as it added, or
+ * one less: a linearizable size stays within [prefill, prefill + n_threads].
+ */
+static void check_sizes(const struct timespec *timeout,
+                        long prefill,
+                        int n_threads,
+                        unsigned long *checks,
+                        unsigned long *wrong)
+{
+    struct timespec now, end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    end.tv_sec += timeout->tv_sec;
+    end.tv_nsec += timeout->tv_nsec;
+    if (end.tv_nsec >= 1000000000) {
+        end.tv_sec++;
+        end.tv_nsec -= 1000000000;
+    }
+    do {
+        long size = list_size(the_list);
+        (*checks)++;
+        if (size < prefill || size > prefill + n_threads) {
+            if (!(*wrong)++)
+                fprintf(stderr, "list_size: %ld, outside [%ld, %ld]\n", size,
+                        prefill, prefill + n_threads);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while (now.tv_sec < end.tv_sec ||
+             (now.tv_sec == end.tv_sec && now.tv_nsec < end.tv_nsec));
+}
+
 void catcher(int sig)
 {
     static int nb = 0;
@@ -143,23 +832,78 @@ void catcher(int sig)
         exit(1);
 }
 
+/* zeroed memory that main shares with the processes it forks */
+static void *shared_alloc(size_t size)
+{
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    return p;
+}
+
+#if defined(LIST_SHM)
+/* body of a process forked by -P: map the list at an address of its own,
+ * then run the n threads of data and exit.
+ */
+static void run_process(const char *shm_name, thread_data_t *data, int n)
+{
+    if (!(the_list = list_shm_attach(shm_name))) {
+        /* let main start, so that it finds out */
+        for (int i = 0; i < n; i++)
+            barrier_cross(data[i].barrier);
+        _exit(1);
+    }
+    pthread_t *threads = malloc(n * sizeof(pthread_t));
+    for (int i = 0; i < n; i++) {
+        if (pthread_create(&threads[i], NULL, test, &data[i]) != 0) {
+            fprintf(stderr, "Error creating thread\n");
+            _exit(1);
+        }
+    }
+    for (int i = 0; i < n; i++)
+        pthread_join(threads[i], NULL);
+    _exit(0);
+}
+#endif
+
 int main(int argc, char *const argv[])
 {
     pthread_t *threads;
     pthread_attr_t attr;
-    barrier_t barrier;
+    barrier_t *barrier;
     struct timeval start, end;
     struct timespec timeout;
+    unsigned long size_checks = 0, size_wrong = 0;
 
     thread_data_t *data;
     sigset_t block_set;
 
     /* initially, set parameters to their default values */
     int n_threads = DEFAULT_NUM_THREADS;
-    max_key = DEFAULT_RANGE;
+    range = DEFAULT_RANGE;
     uint32_t updates = DEFAULT_UPDATES;
     finds = DEFAULT_READS;
+    dist_parse(&dist, "uniform");
+    scans = DEFAULT_SCANS;
+    scan_width = DEFAULT_SCAN_WIDTH;
+    batch = DEFAULT_BATCH;
+    group = DEFAULT_GROUP;
     int duration = DEFAULT_DURATION;
+    const char *pin_list = NULL;
+    const char *record_path = NULL, *replay_path = NULL;
+    const char *load_path = NULL, *save_path = NULL;
+    bool bulk = false;
+    int processes = 1;
+    pid_t *pids = NULL;
+#if defined(LIST_SHM)
+    char shm_name[64];
+    snprintf(shm_name, sizeof(shm_name), "/lists-%d", (int) getpid());
+#endif
+    bool threads_set = false;
+    int format = FORMAT_TEXT;
 
     /* now read the parameters in case the user provided values for them.
      * we use getopt, the same skeleton may be used for other bechmarks,
@@ -173,12 +917,33 @@ int main(int argc, char *const argv[])
         {"initial", required_argument, NULL, 'i'},
         {"num-threads", required_argument, NULL, 'n'},
         {"updates", required_argument, NULL, 'u'},
+        {"huge-pages", no_argument, NULL, 'H'},
+        {"scans", required_argument, NULL, 's'},
+        {"scan-width", required_argument, NULL, 'w'},
+        {"batch", required_argument, NULL, 'b'},
+        {"group", required_argument, NULL, 'G'},
+        {"map", no_argument, NULL, 'M'},
+        {"check-size", no_argument, NULL, 'C'},
+        {"dist", required_argument, NULL, 'D'},
+        {"latency", no_argument, NULL, 'L'},
+        {"pin", required_argument, NULL, 'p'},
+        {"record", required_argument, NULL, 'R'},
+        {"replay", required_argument, NULL, 'T'},
+        {"format", required_argument, NULL, 'o'},
+        {"perf-events", no_argument, NULL, 'E'},
+        {"events", required_argument, NULL, 'e'},
+        {"key-offset", required_argument, NULL, 'k'},
+        {"accel", required_argument, NULL, 'A'},
+        {"bulk", no_argument, NULL, 'B'},
+        {"load", required_argument, NULL, 'I'},
+        {"save", required_argument, NULL, 'S'},
+        {"processes", required_argument, NULL, 'P'},
         {NULL, 0, NULL, 0}};
 
     /* actually get the parameters form the command-line */
     while (1) {
         int i = 0;
-        int c = getopt_long(argc, argv, "hd:n:l:u:i:r:", long_options, &i);
+        int c = getopt_long(argc, argv, "hHLBEMCd:n:l:u:i:r:s:w:b:G:D:p:R:T:o:e:k:A:I:S:P:", long_options, &i);
         if (c == -1)
             break;
 
@@ -204,8 +969,55 @@ int main(int argc, char *const argv[])
                    "        Percentage of update operations (default=" XSTR(DEFAULT_UPDATES) ")\n"
                    "  -r, --range <int>\n"
                    "        Key range (default=" XSTR(DEFAULT_RANGE) ")\n"
+                   "  -k, --key-offset <int>\n"
+                   "        First key of the range, any 64-bit integer (default=0)\n"
                    "  -n, --num-threads <int>\n"
-                   "        Number of threads (default=" XSTR(DEFAULT_NUM_THREADS) ")\n",
+                   "        Number of threads (default=" XSTR(DEFAULT_NUM_THREADS) ")\n"
+                   "  -H, --huge-pages\n"
+                   "        Back the node slabs with transparent huge pages\n"
+                   "  -s, --scans <int>\n"
+                   "        Percentage of range scans, out of the reads (default=" XSTR(DEFAULT_SCANS) ")\n"
+                   "  -w, --scan-width <int>\n"
+                   "        Number of keys covered by a range scan (default=" XSTR(DEFAULT_SCAN_WIDTH) ")\n"
+                   "  -b, --batch <int>\n"
+                   "        Number of sorted keys handled by each operation (default=" XSTR(DEFAULT_BATCH) ")\n"
+                   "  -G, --group <int>\n"
+                   "        Number of lookups interleaved by each find (default=" XSTR(DEFAULT_GROUP) ")\n"
+                   "  -M, --map\n"
+                   "        Use the map operations, and check the payloads they return\n"
+                   "  -C, --check-size\n"
+                   "        Call list_size during the run, and check it against the updates\n"
+                   "  -D, --dist <name>\n"
+                   "        Key distribution: uniform (default), clustered, sequential, monotonic,\n"
+                   "        zipf[:theta] (default=" XSTR(DEFAULT_ZIPF_THETA) "), latest[:theta] or\n"
+                   "        hotspot[:ops:keys] (percentages, default=" XSTR(DEFAULT_HOT_OPS) ":" XSTR(DEFAULT_HOT_KEYS) ")\n"
+                   "  -L, --latency\n"
+                   "        Report latency percentiles per operation type\n"
+                   "  -p, --pin <policy>\n"
+                   "        Thread placement: none (default), compact, scatter or a cpu list (e.g. 0-3,8)\n"
+                   "  -R, --record <file>\n"
+                   "        Record the operations of every thread into a trace file\n"
+                   "  -T, --replay <file>\n"
+                   "        Replay a trace file once instead of the synthetic workload\n"
+                   "        (one thread per stream by default)\n"
+                   "  -o, --format <name>\n"
+                   "        Output format of the results: text (default), json or csv\n"
+                   "  -E, --perf-events\n"
+                   "        Count events of the measured phase with perf_event_open:\n"
+                   "        " PERF_DEFAULT_EVENTS "\n"
+                   "  -e, --events <list>\n"
+                   "        Count the comma-separated events of <list> instead\n"
+                   "  -A, --accel <int>\n"
+                   "        Answer lookups from a sorted copy of the keys, rebuilt after <int>\n"
+                   "        lookups of a thread found it out of date (default=0, disabled)\n"
+                   "  -B, --bulk\n"
+                   "        Fill the list with a single sorted bulk load instead of per-thread inserts\n"
+                   "  -I, --load <file>\n"
+                   "        Fill the list from a dump file instead of random keys\n"
+                   "  -S, --save <file>\n"
+                   "        Save the list to a dump file at the end of the run\n"
+                   "  -P, --processes <int>\n"
+                   "        Run -n threads in each of <int> processes sharing the list (default=1)\n",
 		   argv[0]
             );
             exit(0);
@@ -216,8 +1028,28 @@ int main(int argc, char *const argv[])
             updates = atoi(optarg);
             finds = 100 - updates;
             break;
-        case 'r':
-            max_key = atoi(optarg);
+        case 'r': {
+            unsigned long long r = strtoull(optarg, NULL, 10);
+            range = r > UINT32_MAX ? 0 : r; /* 0 is rejected below */
+            break;
+        }
+        case 'k':
+            key_offset = strtoll(optarg, NULL, 10);
+            break;
+        case 'A':
+            accel = atoi(optarg);
+            break;
+        case 'B':
+            bulk = true;
+            break;
+        case 'I':
+            load_path = optarg;
+            break;
+        case 'S':
+            save_path = optarg;
+            break;
+        case 'P':
+            processes = atoi(optarg);
             break;
         case 'i':
             break;
@@ -225,6 +1057,77 @@ int main(int argc, char *const argv[])
             break;
         case 'n':
             n_threads = atoi(optarg);
+            threads_set = true;
+            break;
+        case 'H':
+            alloc_huge_pages(true);
+            break;
+        case 'L':
+            latency = true;
+            break;
+        case 'R':
+            record_path = optarg;
+            recording = true;
+            break;
+        case 'T':
+            replay_path = optarg;
+            break;
+        case 'p':
+            if (!strcmp(optarg, "none")) {
+                pin = PIN_NONE;
+            } else if (!strcmp(optarg, "compact")) {
+                pin = PIN_COMPACT;
+            } else if (!strcmp(optarg, "scatter")) {
+                pin = PIN_SCATTER;
+            } else {
+                pin = PIN_LIST;
+                pin_list = optarg;
+            }
+            break;
+        case 's':
+            scans = atoi(optarg);
+            break;
+        case 'w':
+            scan_width = atoi(optarg);
+            break;
+        case 'b':
+            batch = atoi(optarg);
+            break;
+        case 'G':
+            group = atoi(optarg);
+            break;
+        case 'M':
+            map = true;
+            break;
+        case 'C':
+            check_size = true;
+            break;
+        case 'D':
+            if (dist_parse(&dist, optarg) != 0) {
+                fprintf(stderr, "Unknown key distribution: %s\n", optarg);
+                exit(1);
+            }
+            dist_spec = optarg;
+            break;
+        case 'E':
+            if (perf_select(PERF_DEFAULT_EVENTS) < 0)
+                exit(1);
+            break;
+        case 'e':
+            if (perf_select(optarg) < 0)
+                exit(1);
+            break;
+        case 'o':
+            if (!strcmp(optarg, "text")) {
+                format = FORMAT_TEXT;
+            } else if (!strcmp(optarg, "json")) {
+                format = FORMAT_JSON;
+            } else if (!strcmp(optarg, "csv")) {
+                format = FORMAT_CSV;
+            } else {
+                fprintf(stderr, "Unknown output format: %s\n", optarg);
+                exit(1);
+            }
             break;
         case '?':
             printf("Use -h or --help for help\n");
@@ -234,52 +1137,248 @@ int main(int argc, char *const argv[])
         }
     }
 
-    max_key--;
-    /* we round the max key up to the nearest power of 2, which makes our random
-     * key generation more efficient.
-     */
-    max_key = next_power_of_two(max_key) - 1;
+#if !defined(LIST_RANGE)
+    if (scans > 0) {
+        fprintf(stderr, "Range scans are not supported by this list\n");
+        exit(1);
+    }
+#endif
+#if !defined(LIST_ACCEL)
+    if (accel) {
+        fprintf(stderr, "The read accelerator is not supported by this list\n");
+        exit(1);
+    }
+#endif
+#if !defined(LIST_BULK)
+    if (bulk || load_path || save_path) {
+        fprintf(stderr, "Bulk loads and dumps are not supported by this list\n");
+        exit(1);
+    }
+#endif
+#if !defined(LIST_SHM)
+    if (processes > 1) {
+        fprintf(stderr, "Several processes are not supported by this list\n");
+        exit(1);
+    }
+#endif
+    if (processes < 1) {
+        fprintf(stderr, "Invalid number of processes\n");
+        exit(1);
+    }
+    /* the threads of the other processes keep their buffers and counters */
+    if (processes > 1 && (latency || record_path || replay_path || perf_events())) {
+        fprintf(stderr, "-P cannot be combined with -L, -R, -T, -E or -e\n");
+        exit(1);
+    }
+#if !defined(LIST_BATCH)
+    if (batch > 1) {
+        fprintf(stderr, "Batched operations are not supported by this list\n");
+        exit(1);
+    }
+#endif
+    if (batch < 1) {
+        fprintf(stderr, "Invalid batch size\n");
+        exit(1);
+    }
+#if !defined(LIST_MULTI)
+    if (group > 1) {
+        fprintf(stderr, "Interleaved lookups are not supported by this list\n");
+        exit(1);
+    }
+#endif
+    if (group < 1 || (group > 1 && batch > 1)) {
+        fprintf(stderr, "Invalid group size, or combined with -b\n");
+        exit(1);
+    }
+#if !defined(LIST_MAP)
+    if (map) {
+        fprintf(stderr, "Map operations are not supported by this list\n");
+        exit(1);
+    }
+#endif
+    /* a batch may add several values at once, see check_sizes */
+    if (check_size && (batch > 1 || replay_path || duration <= 0)) {
+        fprintf(stderr, "-C cannot be combined with -b or -T, and needs -d\n");
+        exit(1);
+    }
+    /* the prefill of -B and -I does not have the payloads of -M */
+    if (map && (batch > 1 || group > 1 || bulk || load_path)) {
+        fprintf(stderr, "-M cannot be combined with -b, -G, -B or -I\n");
+        exit(1);
+    }
+    if (scans > finds || scan_width < 1) {
+        fprintf(stderr, "Invalid range scan parameters\n");
+        exit(1);
+    }
 
-    /* initialization of the list */
-    the_list = list_new();
+    cpu_info_t *placement = NULL;
+    int n_cpus = 0;
+    if (pin != PIN_NONE &&
+        (n_cpus = topology_place(pin, pin_list, &placement)) <= 0) {
+        fprintf(stderr, "Invalid cpu list: %s\n", pin_list);
+        exit(1);
+    }
 
-    /* initialize the data which will be passed to the threads */
-    if ((data = malloc(n_threads * sizeof(thread_data_t))) == NULL) {
-        perror("malloc");
+    static trace_t replay_trace;
+    if (replay_path) {
+        if (recording || batch > 1 || group > 1 || map) {
+            fprintf(stderr, "A trace cannot be replayed with -R, -b, -G or -M\n");
+            exit(1);
+        }
+        if (trace_open(&replay_trace, replay_path) != 0)
+            exit(1);
+        trace = &replay_trace;
+        if (!threads_set)
+            n_threads = trace->header->streams;
+        if (n_threads > trace->header->streams) {
+            fprintf(stderr, "The trace has only %u streams\n",
+                    trace->header->streams);
+            exit(1);
+        }
+#if !defined(LIST_RANGE)
+        for (int i = 0; i < n_threads; i++)
+            for (uint64_t j = 0; j < trace->streams[i].count; j++)
+                if (trace_op(trace_records(trace, i)[j]) == TRACE_SCAN) {
+                    fprintf(stderr, "Range scans are not supported by this list\n");
+                    exit(1);
+                }
+#endif
+    }
+    if (recording && (batch > 1 || group > 1 || map)) {
+        fprintf(stderr, "Batched, grouped or map operations cannot be recorded\n");
+        exit(1);
+    }
+    if ((bulk || load_path) && (replay_path || (recording && load_path))) {
+        fprintf(stderr, "A loaded list cannot be replayed or recorded\n");
         exit(1);
     }
 
+    /* VAL_MIN and VAL_MAX belong to the sentinels */
+    if (range < 2 || key_offset == VAL_MIN || key_offset > VAL_MAX - range) {
+        fprintf(stderr, "Invalid key range\n");
+        exit(1);
+    }
+#if defined(LIST_HASH)
+    /* the split order drops the two upper bits of the keys */
+    if (key_offset < 0 || key_offset > (INT64_C(1) << 62) - range) {
+        fprintf(stderr, "This list only holds keys within [0, 2^62)\n");
+        exit(1);
+    }
+#endif
+    if (recording && (key_offset < -(INT64_C(1) << 61) ||
+                      key_offset > (INT64_C(1) << 61) - range)) {
+        fprintf(stderr, "Traces only hold keys within [-2^61, 2^61)\n");
+        exit(1);
+    }
+    dist_init(&dist, range);
+    uint32_t max_key = range - 1;
+    rss_reset();
+
+    /* initialization of the list */
+#if defined(LIST_BULK)
+    val_t *bulk_keys = NULL;
+    size_t bulk_pos = 0;
+    if (load_path) {
+        if (!(the_list = list_load(load_path)))
+            exit(1);
+        prefilled = true;
+    } else if (bulk) {
+        seeds = seed_rand();
+        bulk_keys = prefill_keys(max_key / 2);
+        the_list = list_build_from_sorted(bulk_keys, max_key / 2);
+        prefilled = true;
+    } else
+#endif
+#if defined(LIST_SHM)
+    /* leave room for four nodes per key, plus the chunks of the threads;
+     * the region only takes memory as it is used
+     */
+    the_list = list_shm_create(processes > 1 ? shm_name : NULL,
+                               (size_t) range * 64 + (256UL << 20));
+    if (!the_list)
+        exit(1);
+#else
+        the_list = list_new();
+#endif
+#if defined(LIST_ACCEL)
+    list_accel(the_list, accel);
+#endif
+
+    /* with -P, -n is the number of threads of each process */
+    n_threads *= processes;
+
+    /* initialize the data which will be passed to the threads */
+    data = shared_alloc(n_threads * sizeof(thread_data_t));
+
     if ((threads = malloc(n_threads * sizeof(pthread_t))) == NULL) {
         perror("malloc");
         exit(1);
     }
 
     /* flag signaling the threads until when to run */
+    running = shared_alloc(64);
     *running = 1;
 
     /* global barrier init (used to start the threads at the same time) */
-    barrier_init(&barrier, n_threads + 1);
+    barrier = shared_alloc(sizeof(barrier_t));
+    barrier_init(barrier, n_threads + 1);
     pthread_attr_init(&attr);
     pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
 
     timeout.tv_sec = duration / 1000;
     timeout.tv_nsec = (duration % 1000) * 1000000;
 
-    /* set the data for each thread and create the threads */
+    /* set the data for each thread */
     for (int i = 0; i < n_threads; i++) {
         data[i].id = i;
         data[i].n_ops = 0;
         data[i].n_insert = 0;
         data[i].n_remove = 0;
         data[i].n_search = 0;
+        data[i].n_scan = 0;
+        data[i].lat = NULL;
+        data[i].perf.n = 0;
+        data[i].cpu = pin != PIN_NONE ? &placement[i % n_cpus] : NULL;
         data[i].n_add = max_key / (2 * n_threads);
         if (i < ((max_key / 2) % n_threads))
             data[i].n_add++;
-        data[i].barrier = &barrier;
-        if (pthread_create(&threads[i], &attr, test, (void *) (&data[i])) !=
-            0) {
-            fprintf(stderr, "Error creating thread\n");
-            exit(1);
+        memset(&data[i].rec, 0, sizeof(trace_buf_t));
+#if defined(LIST_BULK)
+        if (load_path)
+            data[i].n_add = i == 0 ? list_size(the_list) : 0;
+        /* the keys of the bulk load make up the prefill of the threads */
+        for (uint64_t j = 0; bulk_keys && recording && j < data[i].n_add; j++)
+            trace_push(&data[i].rec, TRACE_ADD, bulk_keys[bulk_pos++]);
+#endif
+        data[i].barrier = barrier;
+    }
+#if defined(LIST_BULK)
+    free(bulk_keys);
+#endif
+
+    /* create the threads, or the processes that run them */
+    if (processes > 1) {
+        pids = malloc(processes * sizeof(pid_t));
+        fflush(stdout);
+        for (int p = 0; p < processes; p++) {
+            if ((pids[p] = fork()) < 0) {
+                perror("fork");
+                exit(1);
+            }
+#if defined(LIST_SHM)
+            if (pids[p] == 0) {
+                int n = n_threads / processes;
+                run_process(shm_name, &data[p * n], n);
+            }
+#endif
+        }
+    } else {
+        for (int i = 0; i < n_threads; i++) {
+            if (pthread_create(&threads[i], &attr, test,
+                               (void *) (&data[i])) != 0) {
+                fprintf(stderr, "Error creating thread\n");
+                exit(1);
+            }
         }
     }
     pthread_attr_destroy(&attr);
@@ -293,9 +1392,26 @@ int main(int argc, char *const argv[])
     }
 
     /* Start threads */
-    barrier_cross(&barrier);
+    barrier_cross(barrier);
+#if defined(LIST_SHM)
+    /* every process has mapped the list by now */
+    if (processes > 1)
+        shm_unlink(shm_name);
+#endif
+    for (int i = 0; i < n_threads; i++)
+        perf_enable(&data[i].perf);
     gettimeofday(&start, NULL);
-    if (duration > 0) {
+    ticks start_ticks = getticks();
+    if (trace) {
+        /* the experiment ends when every stream has been replayed */
+        for (int i = 0; i < n_threads; i++)
+            pthread_join(threads[i], NULL);
+    } else if (check_size) {
+        long prefill = 0;
+        for (int i = 0; i < n_threads; i++)
+            prefill += data[i].n_add;
+        check_sizes(&timeout, prefill, n_threads, &size_checks, &size_wrong);
+    } else if (duration > 0) {
         /* sleep for the duration of the experiment */
         nanosleep(&timeout, NULL);
     } else {
@@ -304,11 +1420,29 @@ int main(int argc, char *const argv[])
     }
 
     /* signal the threads to stop */
+    for (int i = 0; i < n_threads; i++)
+        perf_disable(&data[i].perf);
     *running = 0;
     gettimeofday(&end, NULL);
+    ticks end_ticks = getticks();
 
     /* Wait for thread completion */
-    for (int i = 0; i < n_threads; i++) {
+    long child_rss = 0; /* largest peak of the processes of this run */
+    for (int p = 0; pids && p < processes; p++) {
+        int status;
+        struct rusage usage;
+        if (wait4(pids[p], &status, 0, &usage) < 0 || !WIFEXITED(status) ||
+            WEXITSTATUS(status) != 0) {
+            fprintf(stderr, "Error waiting for process completion\n");
+            exit(1);
+        }
+        if (usage.ru_maxrss > child_rss)
+            child_rss = usage.ru_maxrss;
+    }
+#if defined(__APPLE__)
+    child_rss /= 1024;
+#endif
+    for (int i = 0; i < n_threads && !trace && !pids; i++) {
         if (pthread_join(threads[i], NULL) != 0) {
             fprintf(stderr, "Error waiting for thread completion\n");
             exit(1);
@@ -319,27 +1453,81 @@ int main(int argc, char *const argv[])
     duration = (end.tv_sec * 1000 + end.tv_usec / 1000) -
                (start.tv_sec * 1000 + start.tv_usec / 1000);
 
-    unsigned long operations = 0;
-    long reported_total = 0;
-    /* report some experiment statistics */
+    summary_t sum = {.n_threads = n_threads,
+                     .duration = duration,
+                     .size_checks = size_checks,
+                     .size_wrong = size_wrong};
     for (int i = 0; i < n_threads; i++) {
-        printf("Thread %d\n", i);
-        printf("  #operations   : %lu\n", data[i].n_ops);
-        printf("  #inserts   : %lu\n", data[i].n_insert);
-        printf("  #removes   : %lu\n", data[i].n_remove);
-        operations += data[i].n_ops;
-        reported_total = reported_total + data[i].n_add + data[i].n_insert -
-                         data[i].n_remove;
+        sum.operations += data[i].n_ops;
+        sum.expected += data[i].n_add + data[i].n_insert - data[i].n_remove;
+    }
+    sum.actual = list_size(the_list);
+#if defined(LIST_ACCEL)
+    sum.rebuilds = list_accel_rebuilds(the_list);
+#endif
+    sum.ticks_per_ns =
+        (double) (end_ticks - start_ticks) / (duration * 1000000.0);
+    for (int i = 0; i < n_threads; i++) {
+        perf_read(&data[i].perf, sum.perf);
+        perf_close(&data[i].perf);
     }
+#if defined(STATS)
+    for (int i = 0; i < n_threads; i++)
+        stats_merge(&sum.stats, &data[i].stats);
+#endif
+    alloc_stats(&sum.as);
+#if defined(RECLAIM)
+    reclaim_stats(&sum.rs);
+#endif
 
-    printf("Duration      : %d (ms)\n", duration);
-    printf("#txs     : %lu (%f / s)\n", operations,
-           operations * 1000.0 / duration);
-    printf("Expected size: %ld Actual size: %d\n", reported_total,
-           list_size(the_list));
+    sum.rss = rss_peak();
+    if (child_rss > sum.rss)
+        sum.rss = child_rss;
+
+    /* the variant is named after its binary, out/test-<name> */
+    sum.list = strrchr(argv[0], '/') ? strrchr(argv[0], '/') + 1 : argv[0];
+    if (!strncmp(sum.list, "test-", 5))
+        sum.list += 5;
+
+    /* report some experiment statistics */
+    if (format == FORMAT_JSON)
+        report_json(data, &sum);
+    else if (format == FORMAT_CSV)
+        report_csv(data, &sum);
+    else
+        report_text(data, &sum);
+
+    for (int i = 0; i < n_threads; i++)
+        free(data[i].lat);
+    if (record_path) {
+        trace_header_t h = {.scan_width = scan_width, .range = range};
+        trace_buf_t *bufs = malloc(n_threads * sizeof(trace_buf_t));
+        for (int i = 0; i < n_threads; i++)
+            bufs[i] = data[i].rec;
+        if (trace_write(record_path, &h, bufs, n_threads) != 0)
+            exit(1);
+        free(bufs);
+        for (int i = 0; i < n_threads; i++)
+            free(data[i].rec.recs);
+    }
+    if (trace)
+        trace_close(trace);
+#if defined(LIST_BULK)
+    if (save_path && list_save(the_list, save_path) != 0)
+        exit(1);
+#endif
 
+    list_delete(the_list);
+    /* give the memory back before out/lists runs the next variant */
+    alloc_release();
+#if defined(__GLIBC__)
+    malloc_trim(0);
+#endif
+    dist_destroy(&dist);
+    free(placement);
     free(threads);
-    free(data);
+    free(pids);
+    munmap(data, n_threads * sizeof(thread_data_t));
 
     return 0;
 }
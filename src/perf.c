@@ -0,0 +1,173 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "perf.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define HW_CACHE(cache, op, result)                                      \
+    (PERF_COUNT_HW_CACHE_##cache | (PERF_COUNT_HW_CACHE_OP_##op << 8) | \
+     (PERF_COUNT_HW_CACHE_RESULT_##result << 16))
+
+static const struct perf_event_def {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} perf_defs[] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"cache-references", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+    {"cache-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"branches", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+    {"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {"L1-dcache-loads", PERF_TYPE_HW_CACHE, HW_CACHE(L1D, READ, ACCESS)},
+    {"L1-dcache-load-misses", PERF_TYPE_HW_CACHE, HW_CACHE(L1D, READ, MISS)},
+    {"L1-dcache-stores", PERF_TYPE_HW_CACHE, HW_CACHE(L1D, WRITE, ACCESS)},
+    {"L1-dcache-store-misses", PERF_TYPE_HW_CACHE, HW_CACHE(L1D, WRITE, MISS)},
+    {"LLC-loads", PERF_TYPE_HW_CACHE, HW_CACHE(LL, READ, ACCESS)},
+    {"LLC-load-misses", PERF_TYPE_HW_CACHE, HW_CACHE(LL, READ, MISS)},
+    {"LLC-stores", PERF_TYPE_HW_CACHE, HW_CACHE(LL, WRITE, ACCESS)},
+    {"LLC-store-misses", PERF_TYPE_HW_CACHE, HW_CACHE(LL, WRITE, MISS)},
+    {"dTLB-load-misses", PERF_TYPE_HW_CACHE, HW_CACHE(DTLB, READ, MISS)},
+    {"task-clock", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    {"page-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+    {"context-switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    {"cpu-migrations", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS},
+};
+
+#define PERF_DEFS (sizeof(perf_defs) / sizeof(perf_defs[0]))
+
+static const struct perf_event_def *selected[PERF_MAX_EVENTS];
+static int n_selected;
+
+int perf_select(const char *list)
+{
+    n_selected = 0;
+    while (*list) {
+        size_t len = strcspn(list, ",");
+        int i = 0;
+        while (i < PERF_DEFS && (strlen(perf_defs[i].name) != len ||
+                                 strncmp(perf_defs[i].name, list, len)))
+            i++;
+        if (i == PERF_DEFS) {
+            fprintf(stderr, "Unknown perf event: %.*s\n", (int) len, list);
+            return -1;
+        }
+        if (n_selected == PERF_MAX_EVENTS) {
+            fprintf(stderr, "At most %d perf events\n", PERF_MAX_EVENTS);
+            return -1;
+        }
+        selected[n_selected++] = &perf_defs[i];
+        list += len;
+        if (*list == ',')
+            list++;
+    }
+    return n_selected;
+}
+
+int perf_events(void)
+{
+    return n_selected;
+}
+
+const char *perf_event_name(int i)
+{
+    return selected[i]->name;
+}
+
+int perf_open(perf_counters_t *c)
+{
+    c->n = 0;
+    for (int i = 0; i < n_selected; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = selected[i]->type;
+        attr.config = selected[i]->config;
+        attr.disabled = 1;
+        /* software events are counted by the kernel on our behalf */
+        attr.exclude_kernel = selected[i]->type != PERF_TYPE_SOFTWARE;
+        attr.exclude_hv = 1;
+        attr.read_format =
+            PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        /* this thread, on any cpu */
+        int fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fd < 0) {
+            fprintf(stderr, "Cannot open perf event %s: %s\n",
+                    selected[i]->name, strerror(errno));
+            perf_close(c);
+            return -1;
+        }
+        c->fds[c->n++] = fd;
+    }
+    return 0;
+}
+
+void perf_enable(perf_counters_t *c)
+{
+    for (int i = 0; i < c->n; i++)
+        ioctl(c->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+}
+
+void perf_disable(perf_counters_t *c)
+{
+    for (int i = 0; i < c->n; i++)
+        ioctl(c->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+}
+
+void perf_read(perf_counters_t *c, uint64_t *values)
+{
+    for (int i = 0; i < c->n; i++) {
+        uint64_t v[3]; /* value, time enabled, time running */
+        if (read(c->fds[i], v, sizeof(v)) != sizeof(v) || !v[2])
+            continue;
+        values[i] += v[2] < v[1] ? (uint64_t) ((double) v[0] * v[1] / v[2])
+                                 : v[0];
+    }
+}
+
+void perf_close(perf_counters_t *c)
+{
+    for (int i = 0; i < c->n; i++)
+        close(c->fds[i]);
+    c->n = 0;
+}
+
+#else
+int perf_select(const char *list)
+{
+    fprintf(stderr, "Perf events are only supported on Linux\n");
+    return -1;
+}
+
+int perf_events(void)
+{
+    return 0;
+}
+
+const char *perf_event_name(int i)
+{
+    return NULL;
+}
+
+int perf_open(perf_counters_t *c)
+{
+    c->n = 0;
+    return -1;
+}
+
+void perf_enable(perf_counters_t *c) {}
+
+void perf_disable(perf_counters_t *c) {}
+
+void perf_read(perf_counters_t *c, uint64_t *values) {}
+
+void perf_close(perf_counters_t *c) {}
+#endif
@@ -0,0 +1,138 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "reclaim.h"
+
+__thread reclaim_thread_t *reclaim_self;
+uint64_t reclaim_epoch ALIGNED(64);
+
+/* all the threads that ever took part in reclamation; records are never
+ * removed, so the list can be walked without synchronization.
+ */
+static reclaim_thread_t *reclaim_threads;
+
+static inline reclaim_thread_t *first_thread(void)
+{
+    return __atomic_load_n(&reclaim_threads, __ATOMIC_ACQUIRE);
+}
+
+reclaim_thread_t *reclaim_register(void)
+{
+    reclaim_thread_t *self;
+    if (posix_memalign((void **) &self, 64, sizeof(reclaim_thread_t)) != 0)
+        abort();
+    memset(self, 0, sizeof(reclaim_thread_t));
+
+    reclaim_thread_t *head;
+    do {
+        head = first_thread();
+        self->next = head;
+    } while (CAS_PTR(&reclaim_threads, head, self) != head);
+
+    reclaim_self = self;
+    return self;
+}
+
+/* free a retired node, or a block from reclaim_retire_block */
+static inline void retired_free(void *node)
+{
+    if ((uintptr_t) node & 1)
+        free((void *) ((uintptr_t) node & ~(uintptr_t) 1));
+    else
+        node_free(node);
+}
+
+#if RECLAIM == RECLAIM_HP
+static int compare_ptr(const void *a, const void *b)
+{
+    uintptr_t x = (uintptr_t) * (void **) a, y = (uintptr_t) * (void **) b;
+    return (x > y) - (x < y);
+}
+
+/* free every retired node that no thread has in its hazard pointers */
+void reclaim_collect(reclaim_thread_t *self)
+{
+    static __thread void **hazards;
+    static __thread uint32_t capacity;
+
+    uint32_t n = 0;
+    for (reclaim_thread_t *t = first_thread(); t; t = t->next) {
+        if (n + RECLAIM_SLOTS > capacity) {
+            capacity = 2 * (n + RECLAIM_SLOTS);
+            hazards = realloc(hazards, capacity * sizeof(void *));
+        }
+        for (int i = 0; i < RECLAIM_SLOTS; i++) {
+            void *p = __atomic_load_n(&t->hazard[i], __ATOMIC_SEQ_CST);
+            if (p)
+                hazards[n++] = p;
+        }
+    }
+    qsort(hazards, n, sizeof(void *), compare_ptr);
+
+    retire_bag_t *bag = &self->bags[0];
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < bag->count; i++) {
+        void *node = bag->nodes[i];
+        void *addr = (void *) ((uintptr_t) node & ~(uintptr_t) 1);
+        if (bsearch(&addr, hazards, n, sizeof(void *), compare_ptr)) {
+            bag->nodes[kept++] = node;
+        } else {
+            retired_free(node);
+            self->freed++;
+        }
+    }
+    bag->count = kept;
+}
+
+#elif RECLAIM == RECLAIM_EBR
+static void bag_free(reclaim_thread_t *self, retire_bag_t *bag)
+{
+    for (uint32_t i = 0; i < bag->count; i++)
+        retired_free(bag->nodes[i]);
+    self->freed += bag->count;
+    bag->count = 0;
+}
+
+/* advance the global epoch if every active thread has observed it, and free
+ * the bags that were retired at least two epochs ago.
+ */
+void reclaim_collect(reclaim_thread_t *self)
+{
+    uint64_t e = __atomic_load_n(&reclaim_epoch, __ATOMIC_SEQ_CST);
+    bool advance = true;
+    for (reclaim_thread_t *t = first_thread(); t; t = t->next) {
+        uint64_t te = __atomic_load_n(&t->epoch, __ATOMIC_SEQ_CST);
+        if ((te & 1) && (te >> 1) != e) {
+            advance = false;
+            break;
+        }
+    }
+    if (advance)
+        CAS_U64(&reclaim_epoch, e, e + 1);
+
+    e = __atomic_load_n(&reclaim_epoch, __ATOMIC_SEQ_CST);
+    for (int i = 0; i < 3; i++) {
+        retire_bag_t *bag = &self->bags[i];
+        if (bag->count && bag->epoch + 2 <= e)
+            bag_free(self, bag);
+    }
+}
+
+#else
+void reclaim_collect(reclaim_thread_t *self)
+{
+    (void) self;
+}
+#endif
+
+void reclaim_stats(reclaim_stats_t *stats)
+{
+    memset(stats, 0, sizeof(reclaim_stats_t));
+    for (reclaim_thread_t *t = first_thread(); t; t = t->next) {
+        stats->retired += t->retired;
+        stats->freed += t->freed;
+        stats->peak += t->peak;
+    }
+    stats->pending = stats->retired - stats->freed;
+}
@@ -0,0 +1,104 @@
+/* out/lists: run the benchmark of one or several of the list variants linked
+ * in (include/registry.h), one after the other, within the same process.
+ */
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "registry.h"
+
+static void usage(FILE *f, const char *prog)
+{
+    fprintf(f,
+            "Usage:\n"
+            "  %s --impl=<name>[,<name>...] [options...]\n"
+            "\n"
+            "Runs the benchmark of each variant in turn, with the options of\n"
+            "its out/test-<name> binary; all runs every variant.\n"
+            "\n"
+            "Variants:\n",
+            prog);
+    for (const impl_t *impl = __start_impl_table; impl < __stop_impl_table;
+         impl++)
+        fprintf(f, "  %s\n", impl->name);
+}
+
+static const impl_t *impl_find(const char *name, size_t len)
+{
+    for (const impl_t *impl = __start_impl_table; impl < __stop_impl_table;
+         impl++)
+        if (strlen(impl->name) == len && !strncmp(impl->name, name, len))
+            return impl;
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    int n_impls = __stop_impl_table - __start_impl_table;
+    const impl_t **run = calloc(n_impls, sizeof(impl_t *));
+    bool *seen = calloc(n_impls, sizeof(bool));
+    char **args = malloc((argc + 1) * sizeof(char *));
+    const char *names = NULL;
+    int n_args = 1, n_run = 0;
+
+    /* take --impl out of the options passed on to the variants */
+    for (int i = 1; i < argc; i++) {
+        if (!strncmp(argv[i], "--impl=", 7))
+            names = argv[i] + 7;
+        else if (!strcmp(argv[i], "--impl") && i + 1 < argc)
+            names = argv[++i];
+        else
+            args[n_args++] = argv[i];
+    }
+    args[n_args] = NULL;
+    if (!names) {
+        usage(stderr, argv[0]);
+        exit(1);
+    }
+
+    if (!strcmp(names, "all")) {
+        for (int i = 0; i < n_impls; i++)
+            run[n_run++] = &__start_impl_table[i];
+    } else {
+        while (*names) {
+            size_t len = strcspn(names, ",");
+            const impl_t *impl = impl_find(names, len);
+            if (!impl) {
+                fprintf(stderr, "Unknown variant: %.*s\n\n", (int) len, names);
+                usage(stderr, argv[0]);
+                exit(1);
+            }
+            /* the static state of a driver is only initialized once */
+            if (seen[impl - __start_impl_table]) {
+                fprintf(stderr, "Variant %s given twice\n", impl->name);
+                exit(1);
+            }
+            seen[impl - __start_impl_table] = true;
+            run[n_run++] = impl;
+            names += len;
+            if (*names == ',')
+                names++;
+        }
+    }
+
+    if (n_run == 0) {
+        usage(stderr, argv[0]);
+        exit(1);
+    }
+
+    for (int i = 0; i < n_run; i++) {
+        /* the driver reports results under the name of its binary */
+        args[0] = (char *) run[i]->name;
+        optind = 0; /* have getopt start over */
+        int ret = run[i]->run(n_args, args);
+        fflush(stdout);
+        if (ret != 0)
+            exit(ret);
+    }
+
+    free(run);
+    free(seen);
+    free(args);
+    return 0;
+}
@@ -0,0 +1,473 @@
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "atomics.h"
+#include "list.h"
+#include "stats.h"
+#include "utils.h"
+
+/* Harris' lock-free list in a region of shared memory, which several
+ * processes map, each at an address of its own.
+ *
+ * Links are thus offsets from the start of the region instead of pointers;
+ * their low-order bit still marks a node as logically deleted. Nodes are
+ * carved from the region itself: every thread takes chunks of it from a
+ * shared break, and keeps the nodes it frees for its own reuse. Removed
+ * nodes are reclaimed with epoch-based reclamation, as in reclaim.h, but the
+ * global epoch and the epoch of every thread are kept in the region, so a
+ * node is only reused once no thread of any process can still hold it. A
+ * process that dies within an operation stops reclamation in the region.
+ */
+
+#define SHM_MAGIC "LLSHMEM1"
+
+/* threads that can ever operate on a region; a slot is never given back */
+#define SHM_SLOTS 1024
+
+/* bytes a thread takes from the region at a time */
+#define SHM_CHUNK (64UL << 10)
+
+/* size of the regions of list_new, reserved but not backed until used */
+#define SHM_DEFAULT_SIZE (1UL << 30)
+
+/* offset of a node from the start of the region; the low-order bit marks the
+ * node holding the link as logically deleted.
+ */
+typedef uint64_t ref_t;
+
+struct node {
+    val_t data;
+    ref_t next;
+};
+
+typedef struct shm_slot {
+    uint64_t epoch; /* (epoch << 1) | 1 when active, else 0 */
+} ALIGNED(64) shm_slot_t;
+
+/* the beginning of the region; the nodes follow */
+typedef struct shm_region {
+    char magic[8];  /* SHM_MAGIC, not terminated */
+    uint32_t ready; /* set once the creator has initialized the region */
+    uint64_t id;    /* tells the regions mapped at the same address apart */
+    uint64_t size;  /* of the region, in bytes */
+    ref_t head, tail;
+    uint64_t brk ALIGNED(64);   /* offset of the first byte never allocated */
+    uint32_t count ALIGNED(64); /* number of values in the list */
+    uint64_t epoch ALIGNED(64);
+    uint32_t slots_used ALIGNED(64);
+    shm_slot_t slots[SHM_SLOTS];
+} shm_region_t;
+
+struct list {
+    shm_region_t *region; /* as mapped by this process */
+};
+
+/* retired nodes waiting until they can be reused */
+typedef struct shm_bag {
+    ref_t *refs;
+    uint32_t count, capacity;
+    uint64_t epoch; /* in which the nodes were retired */
+} shm_bag_t;
+
+/* state of the calling thread in the last region it operated on */
+static __thread struct {
+    shm_region_t *region;
+    uint64_t id;
+    shm_slot_t *slot;
+    ref_t cur, end; /* unused part of the current chunk */
+    ref_t free;     /* nodes ready for reuse, linked through their next */
+    shm_bag_t bags[3];
+    uint64_t retired;
+} self;
+
+static inline bool is_marked_ref(ref_t r)
+{
+    return r & 1;
+}
+
+static inline ref_t get_unmarked_ref(ref_t r)
+{
+    return r & ~(ref_t) 1;
+}
+
+static inline ref_t get_marked_ref(ref_t r)
+{
+    return r | 1;
+}
+
+static inline node_t *node_at(shm_region_t *region, ref_t r)
+{
+    return (node_t *) ((char *) region + get_unmarked_ref(r));
+}
+
+static void shm_register(shm_region_t *region)
+{
+    for (int i = 0; i < 3; i++)
+        free(self.bags[i].refs);
+    memset(&self, 0, sizeof(self));
+
+    uint32_t i = __atomic_fetch_add(&region->slots_used, 1, __ATOMIC_SEQ_CST);
+    if (i >= SHM_SLOTS) {
+        fprintf(stderr, "More than %d threads used the shared list\n",
+                SHM_SLOTS);
+        exit(1);
+    }
+    self.region = region;
+    self.id = region->id;
+    self.slot = &region->slots[i];
+}
+
+/* advance the epoch of the region if every active thread has observed it,
+ * and make the nodes retired at least two epochs ago reusable.
+ */
+static void shm_collect(shm_region_t *region)
+{
+    uint64_t e = __atomic_load_n(&region->epoch, __ATOMIC_SEQ_CST);
+    uint32_t n = __atomic_load_n(&region->slots_used, __ATOMIC_SEQ_CST);
+    bool advance = true;
+    for (uint32_t i = 0; i < n && i < SHM_SLOTS && advance; i++) {
+        uint64_t te = __atomic_load_n(&region->slots[i].epoch, __ATOMIC_SEQ_CST);
+        advance = !(te & 1) || (te >> 1) == e;
+    }
+    if (advance)
+        CAS_U64(&region->epoch, e, e + 1);
+
+    e = __atomic_load_n(&region->epoch, __ATOMIC_SEQ_CST);
+    for (int i = 0; i < 3; i++) {
+        shm_bag_t *bag = &self.bags[i];
+        if (!bag->count || bag->epoch + 2 > e)
+            continue;
+        for (uint32_t j = 0; j < bag->count; j++) {
+            node_at(region, bag->refs[j])->next = self.free;
+            self.free = bag->refs[j];
+        }
+        bag->count = 0;
+    }
+}
+
+/* bracket every operation, as reclaim_enter and reclaim_exit */
+static inline shm_region_t *shm_enter(list_t *the_list)
+{
+    shm_region_t *region = the_list->region;
+    if (__builtin_expect(self.region != region || self.id != region->id, 0))
+        shm_register(region);
+    uint64_t e = __atomic_load_n(&region->epoch, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&self.slot->epoch, (e << 1) | 1, __ATOMIC_SEQ_CST);
+    shm_bag_t *oldest = &self.bags[(e + 1) % 3];
+    if (oldest->count && oldest->epoch + 2 <= e)
+        shm_collect(region);
+    return region;
+}
+
+static inline void shm_exit(void)
+{
+    __atomic_store_n(&self.slot->epoch, 0, __ATOMIC_RELEASE);
+}
+
+/* hand a node unlinked by the calling thread over to reclamation */
+static void shm_retire(shm_region_t *region, ref_t r)
+{
+    uint64_t e = __atomic_load_n(&region->epoch, __ATOMIC_SEQ_CST);
+    shm_bag_t *bag = &self.bags[e % 3];
+    if (bag->epoch != e) { /* the bag holds nodes from epoch e - 3 or older */
+        shm_collect(region);
+        bag->epoch = e;
+    }
+    if (bag->count == bag->capacity) {
+        bag->capacity = bag->capacity ? 2 * bag->capacity : 64;
+        bag->refs = realloc(bag->refs, bag->capacity * sizeof(ref_t));
+    }
+    bag->refs[bag->count++] = r;
+    if ((++self.retired & 0x3f) == 0) /* amortize the scan */
+        shm_collect(region);
+}
+
+static node_t *new_node(shm_region_t *region, val_t val, ref_t next, ref_t *r)
+{
+    ref_t n = self.free;
+    if (n) {
+        self.free = node_at(region, n)->next;
+    } else {
+        if (self.end - self.cur < sizeof(node_t)) {
+            uint64_t chunk =
+                __atomic_fetch_add(&region->brk, SHM_CHUNK, __ATOMIC_RELAXED);
+            if (chunk + SHM_CHUNK > region->size) {
+                fprintf(stderr, "The shared list is out of memory\n");
+                exit(1);
+            }
+            self.cur = chunk;
+            self.end = chunk + SHM_CHUNK;
+        }
+        n = self.cur;
+        self.cur += sizeof(node_t);
+    }
+    node_t *node = node_at(region, n);
+    node->data = val;
+    node->next = next;
+    *r = n;
+    return node;
+}
+
+/* give back a node that was never linked */
+static inline void free_node(shm_region_t *region, ref_t r)
+{
+    node_at(region, r)->next = self.free;
+    self.free = r;
+}
+
+/* search looks for value val, it
+ *  - returns right_node owning val (if present) or its immediately higher
+ *    value present in the list (otherwise) and
+ *  - sets the left_node to the node owning the value immediately lower than
+ *    val.
+ * Encountered nodes that are marked as logically deleted are physically
+ * removed from the list and retired.
+ */
+static ref_t search(shm_region_t *region, val_t val, ref_t *left_node)
+{
+    ref_t head = region->head, tail = region->tail;
+    ref_t left_node_next = 0, right_node;
+    while (1) {
+        ref_t t = head;
+        ref_t t_next = node_at(region, head)->next;
+        while (is_marked_ref(t_next) || node_at(region, t)->data < val) {
+            if (!is_marked_ref(t_next)) {
+                *left_node = t;
+                left_node_next = t_next;
+            } else {
+                STAT_INC(marked_skipped);
+            }
+            t = get_unmarked_ref(t_next);
+            if (t == tail)
+                break;
+            STAT_INC(traversed);
+            t_next = node_at(region, t)->next;
+        }
+        right_node = t;
+
+        if (left_node_next == right_node) {
+            if (!is_marked_ref(node_at(region, right_node)->next))
+                return right_node;
+        } else if (CAS_U64(&node_at(region, *left_node)->next, left_node_next,
+                           right_node) == left_node_next) {
+            /* the marked chain is ours now, retire it */
+            for (ref_t n = left_node_next; n != right_node;) {
+                ref_t next = get_unmarked_ref(node_at(region, n)->next);
+                STAT_INC(marked_snipped);
+                shm_retire(region, n);
+                n = next;
+            }
+            if (!is_marked_ref(node_at(region, right_node)->next))
+                return right_node;
+        }
+        STAT_INC(search_retries);
+    }
+}
+
+bool list_contains(list_t *the_list, val_t val)
+{
+    shm_region_t *region = shm_enter(the_list);
+    ref_t tail = region->tail;
+    ref_t iterator = get_unmarked_ref(node_at(region, region->head)->next);
+    bool found = false;
+    while (iterator != tail) {
+        STAT_INC(traversed);
+        node_t *node = node_at(region, iterator);
+        ref_t next = node->next;
+        if (!is_marked_ref(next) && node->data >= val) {
+            found = node->data == val;
+            break;
+        }
+        if (is_marked_ref(next))
+            STAT_INC(marked_skipped);
+        iterator = get_unmarked_ref(next);
+    }
+    shm_exit();
+    return found;
+}
+
+bool list_add(list_t *the_list, val_t val)
+{
+    shm_region_t *region = shm_enter(the_list);
+    node_t *new_elem = NULL;
+    ref_t left, r = 0;
+    while (1) {
+        ref_t right = search(region, val, &left);
+        if (right != region->tail && node_at(region, right)->data == val) {
+            if (new_elem) /* allocated by a failed attempt */
+                free_node(region, r);
+            shm_exit();
+            return false;
+        }
+        if (!new_elem)
+            new_elem = new_node(region, val, right, &r);
+        else
+            new_elem->next = right;
+        if (CAS_U64(&node_at(region, left)->next, right, r) == right) {
+            FAI_U32(&region->count);
+            shm_exit();
+            return true;
+        }
+        STAT_INC(cas_failures);
+    }
+}
+
+bool list_remove(list_t *the_list, val_t val)
+{
+    shm_region_t *region = shm_enter(the_list);
+    ref_t left;
+    while (1) {
+        ref_t right = search(region, val, &left);
+        if (right == region->tail || node_at(region, right)->data != val) {
+            shm_exit();
+            return false;
+        }
+
+        node_t *node = node_at(region, right);
+        ref_t right_succ = node->next;
+        if (!is_marked_ref(right_succ) &&
+            CAS_U64(&node->next, right_succ, get_marked_ref(right_succ)) ==
+                right_succ) {
+            if (CAS_U64(&node_at(region, left)->next, right, right_succ) ==
+                right) {
+                STAT_INC(marked_snipped);
+                shm_retire(region, right);
+            } else { /* somebody changed left; let the search unlink it */
+                STAT_INC(cas_failures);
+                search(region, val, &left);
+            }
+            FAD_U32(&region->count);
+            shm_exit();
+            return true;
+        }
+        STAT_INC(cas_failures);
+    }
+}
+
+list_t *list_shm_create(const char *name, size_t size)
+{
+    const size_t first = (sizeof(shm_region_t) + 63) & ~(size_t) 63;
+    if (size < first + 64 + SHM_CHUNK) {
+        fprintf(stderr, "A shared list needs at least %zu bytes\n",
+                first + 64 + SHM_CHUNK);
+        return NULL;
+    }
+
+    void *map;
+    if (name) {
+        int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0) {
+            perror(name);
+            return NULL;
+        }
+        if (ftruncate(fd, size) != 0) {
+            perror(name);
+            close(fd);
+            shm_unlink(name);
+            return NULL;
+        }
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED)
+            shm_unlink(name);
+    } else {
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    }
+    if (map == MAP_FAILED) {
+        perror(name ? name : "mmap");
+        return NULL;
+    }
+
+    /* the sentinels share the first cache line after the header */
+    shm_region_t *region = map;
+    region->id = getticks() ^ ((uint64_t) getpid() << 32);
+    region->size = size;
+    region->head = first;
+    region->tail = first + sizeof(node_t);
+    region->brk = first + 64;
+    node_at(region, region->head)->data = VAL_MIN;
+    node_at(region, region->head)->next = region->tail;
+    node_at(region, region->tail)->data = VAL_MAX;
+    node_at(region, region->tail)->next = 0;
+    memcpy(region->magic, SHM_MAGIC, sizeof(region->magic));
+    __atomic_store_n(&region->ready, 1, __ATOMIC_RELEASE);
+
+    list_t *the_list = malloc(sizeof(list_t));
+    the_list->region = region;
+    return the_list;
+}
+
+list_t *list_shm_attach(const char *name)
+{
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        perror(name);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror(name);
+        close(fd);
+        return NULL;
+    }
+    if (st.st_size < sizeof(shm_region_t)) {
+        fprintf(stderr, "%s: not a shared list\n", name);
+        close(fd);
+        return NULL;
+    }
+    void *map =
+        mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror(name);
+        return NULL;
+    }
+
+    shm_region_t *region = map;
+    if (memcmp(region->magic, SHM_MAGIC, sizeof(region->magic)) ||
+        !__atomic_load_n(&region->ready, __ATOMIC_ACQUIRE) ||
+        region->size != st.st_size) {
+        fprintf(stderr, "%s: not a shared list\n", name);
+        munmap(map, st.st_size);
+        return NULL;
+    }
+    list_t *the_list = malloc(sizeof(list_t));
+    the_list->region = region;
+    return the_list;
+}
+
+list_t *list_new()
+{
+    list_t *the_list = list_shm_create(NULL, SHM_DEFAULT_SIZE);
+    if (!the_list)
+        abort();
+    return the_list;
+}
+
+/* unmap the region from this process; it goes away once every process did,
+ * and, if it has a name, it was unlinked with shm_unlink.
+ */
+void list_delete(list_t *the_list)
+{
+    shm_region_t *region = the_list->region;
+    if (self.region == region) {
+        for (int i = 0; i < 3; i++)
+            free(self.bags[i].refs);
+        memset(&self, 0, sizeof(self));
+    }
+    munmap(region, region->size);
+    free(the_list);
+}
+
+int list_size(list_t *the_list)
+{
+    return __atomic_load_n(&the_list->region->count, __ATOMIC_RELAXED);
+}
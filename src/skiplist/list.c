@@ -0,0 +1,264 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "alloc.h"
+#include "list.h"
+#include "random.h"
+#include "reclaim.h"
+
+/* Lock-free skip list after Fraser and Herlihy, Lev and Shavit: every level
+ * is a Harris list, and the bottom level defines the content of the set.
+ * A node is removed by marking its next pointers from the top level down to
+ * the bottom one; the mark of the bottom level is the linearization point.
+ * Marked nodes are unlinked by the searches that come across them.
+ */
+#define MAX_LEVEL 24
+
+struct node {
+    val_t data;
+    uint32_t toplevel; /* number of levels the node takes part in */
+    uint32_t refs;     /* inserter and remover, see node_release */
+    struct node *next[];
+};
+
+struct list {
+    node_t *head, *tail;
+    uint32_t size;
+};
+
+static inline bool is_marked_ref(void *i)
+{
+    return (bool) ((uintptr_t) i & 0x1L);
+}
+
+static inline void *get_unmarked_ref(void *w)
+{
+    return (void *) ((uintptr_t) w & ~0x1L);
+}
+
+static inline void *get_marked_ref(void *w)
+{
+    return (void *) ((uintptr_t) w | 0x1L);
+}
+
+/* geometric distribution with p = 1/2, from a per-thread xorshift */
+static uint32_t random_level(void)
+{
+    static __thread uint64_t x;
+    if (!x)
+        x = getticks() | 1;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return __builtin_ctzll(x | (1ULL << (MAX_LEVEL - 1))) + 1;
+}
+
+static node_t *new_node(val_t val, uint32_t toplevel)
+{
+    node_t *node =
+        node_alloc(sizeof(node_t) + toplevel * sizeof(node_t *));
+    node->data = val;
+    node->toplevel = toplevel;
+    node->refs = 2;
+    return node;
+}
+
+/* A node can only be retired once it is unreachable at every level. The
+ * remover unlinks it with a search after marking it, but the inserter may
+ * still be linking upper levels at that point, so it searches again when it
+ * finds the node marked. Each of them drops one reference when done, and
+ * the last one retires the node.
+ */
+static inline void node_release(node_t *node)
+{
+    if (__atomic_sub_fetch(&node->refs, 1, __ATOMIC_ACQ_REL) == 0)
+        reclaim_retire(node);
+}
+
+/* list_search looks for value val at every level; it
+ *  - sets succs[i] to the first node owning val or a higher value at level i,
+ *  - sets preds[i] to its predecessor at level i, and
+ *  - returns true if the node at the bottom level owns val.
+ * Marked nodes encountered on the way are unlinked.
+ */
+static bool list_search(list_t *set,
+                        val_t val,
+                        node_t **preds,
+                        node_t **succs)
+{
+    node_t *pred, *curr, *succ;
+retry:
+    pred = set->head;
+    for (int level = MAX_LEVEL - 1; level >= 0; level--) {
+        curr = get_unmarked_ref(pred->next[level]);
+        while (1) {
+            succ = curr->next[level];
+            while (is_marked_ref(succ)) {
+                if (CAS_PTR(&pred->next[level], curr, get_unmarked_ref(succ)) !=
+                    curr)
+                    goto retry;
+                curr = get_unmarked_ref(pred->next[level]);
+                succ = curr->next[level];
+            }
+            if (curr->data >= val)
+                break;
+            pred = curr;
+            curr = get_unmarked_ref(succ);
+        }
+        preds[level] = pred;
+        succs[level] = curr;
+    }
+    return succs[0] != set->tail && succs[0]->data == val;
+}
+
+/* return true if there is a node in the list owning value val. Marked nodes
+ * are skipped, not unlinked, so no writes are needed.
+ */
+bool list_contains(list_t *the_list, val_t val)
+{
+    node_t *pred, *curr, *succ;
+    reclaim_enter();
+    pred = the_list->head;
+    curr = NULL;
+    for (int level = MAX_LEVEL - 1; level >= 0; level--) {
+        curr = get_unmarked_ref(pred->next[level]);
+        while (1) {
+            succ = curr->next[level];
+            while (is_marked_ref(succ)) {
+                curr = get_unmarked_ref(succ);
+                succ = curr->next[level];
+            }
+            if (curr->data >= val)
+                break;
+            pred = curr;
+            curr = get_unmarked_ref(succ);
+        }
+    }
+    bool found = curr != the_list->tail && curr->data == val;
+    reclaim_exit();
+    return found;
+}
+
+list_t *list_new()
+{
+    /* allocate list */
+    list_t *the_list = malloc(sizeof(list_t));
+
+    /* now need to create the sentinel nodes, which span all levels */
+    the_list->head = new_node(VAL_MIN, MAX_LEVEL);
+    the_list->tail = new_node(VAL_MAX, MAX_LEVEL);
+    for (int i = 0; i < MAX_LEVEL; i++) {
+        the_list->head->next[i] = the_list->tail;
+        the_list->tail->next[i] = NULL;
+    }
+    the_list->size = 0;
+    return the_list;
+}
+
+/* free the list and all the nodes still linked in it; the caller must make
+ * sure no other thread is operating on the list.
+ */
+void list_delete(list_t *the_list)
+{
+    node_t *elem = the_list->head;
+    while (elem) {
+        node_t *next = get_unmarked_ref(elem->next[0]);
+        node_free(elem);
+        elem = next;
+    }
+    free(the_list);
+}
+
+int list_size(list_t *the_list)
+{
+    return the_list->size;
+}
+
+bool list_add(list_t *the_list, val_t val)
+{
+    node_t *preds[MAX_LEVEL], *succs[MAX_LEVEL];
+    node_t *new_elem = NULL;
+    reclaim_enter();
+    while (1) {
+        if (list_search(the_list, val, preds, succs)) {
+            reclaim_exit();
+            node_free(new_elem); /* allocated by a failed attempt */
+            return false;
+        }
+
+        /* only allocate once we know the value is absent */
+        if (!new_elem)
+            new_elem = new_node(val, random_level());
+        for (uint32_t i = 0; i < new_elem->toplevel; i++)
+            new_elem->next[i] = succs[i];
+
+        /* linking the bottom level inserts the value */
+        if (CAS_PTR(&preds[0]->next[0], succs[0], new_elem) == succs[0])
+            break;
+    }
+    FAI_U32(&(the_list->size));
+
+    /* then link the upper levels, bottom-up */
+    for (uint32_t i = 1; i < new_elem->toplevel; i++) {
+        while (1) {
+            node_t *succ = succs[i];
+            node_t *next = new_elem->next[i];
+            if (is_marked_ref(next)) /* concurrently removed */
+                goto done;
+            if (next != succ && CAS_PTR(&new_elem->next[i], next, succ) != next)
+                goto done;
+            if (CAS_PTR(&preds[i]->next[i], succ, new_elem) == succ)
+                break;
+            list_search(the_list, val, preds, succs);
+            if (succs[0] != new_elem)
+                goto done;
+        }
+    }
+done:
+    /* a remover may have searched before we linked some levels */
+    if (is_marked_ref(new_elem->next[0]))
+        list_search(the_list, val, preds, succs);
+    node_release(new_elem);
+    reclaim_exit();
+    return true;
+}
+
+bool list_remove(list_t *the_list, val_t val)
+{
+    node_t *preds[MAX_LEVEL], *succs[MAX_LEVEL];
+    reclaim_enter();
+    if (!list_search(the_list, val, preds, succs)) {
+        reclaim_exit();
+        return false;
+    }
+
+    node_t *victim = succs[0];
+    /* mark the upper levels, top-down */
+    for (int i = victim->toplevel - 1; i >= 1; i--) {
+        node_t *succ = victim->next[i];
+        while (!is_marked_ref(succ)) {
+            CAS_PTR(&victim->next[i], succ, get_marked_ref(succ));
+            succ = victim->next[i];
+        }
+    }
+
+    /* whoever marks the bottom level removes the value */
+    node_t *succ = victim->next[0];
+    while (1) {
+        if (is_marked_ref(succ)) {
+            reclaim_exit();
+            return false;
+        }
+        node_t *old = CAS_PTR(&victim->next[0], succ, get_marked_ref(succ));
+        if (old == succ)
+            break;
+        succ = old;
+    }
+    FAD_U32(&(the_list->size));
+
+    list_search(the_list, val, preds, succs); /* unlink it everywhere */
+    node_release(victim);
+    reclaim_exit();
+    return true;
+}
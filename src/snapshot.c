@@ -0,0 +1,135 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "snapshot.h"
+
+uint64_t snap_clock ALIGNED(64) = 1;
+uint32_t snap_active ALIGNED(64);
+
+static __thread snap_thread_t *snap_self;
+
+/* all the threads that ever ran a range query; records are never removed */
+static snap_thread_t *snap_threads;
+
+static inline snap_thread_t *first_thread(void)
+{
+    return __atomic_load_n(&snap_threads, __ATOMIC_ACQUIRE);
+}
+
+static snap_thread_t *snap_register(void)
+{
+    snap_thread_t *self;
+    if (posix_memalign((void **) &self, 64, sizeof(snap_thread_t)) != 0)
+        abort();
+    memset(self, 0, sizeof(snap_thread_t));
+    self->ts = SNAP_IDLE;
+
+    snap_thread_t *head;
+    do {
+        head = first_thread();
+        self->next = head;
+    } while (CAS_PTR(&snap_threads, head, self) != head);
+
+    snap_self = self;
+    return self;
+}
+
+/* report the node to every range query whose snapshot may predate del_ts.
+ * A range query announcing itself after we looked at it takes its snapshot
+ * after del_ts was set, and does not need the node.
+ */
+void snap_report(val_t key, uint64_t ins_ts, uint64_t del_ts)
+{
+    for (snap_thread_t *t = first_thread(); t; t = t->next) {
+        if (__atomic_load_n(&t->ts, __ATOMIC_SEQ_CST) >= del_ts)
+            continue;
+
+        snap_report_t *r = node_alloc(sizeof(snap_report_t));
+        r->key = key;
+        r->ins_ts = ins_ts;
+        r->del_ts = del_ts;
+        snap_report_t *head;
+        do {
+            head = __atomic_load_n(&t->reports, __ATOMIC_ACQUIRE);
+            r->next = head;
+        } while (CAS_PTR(&t->reports, head, r) != head);
+    }
+}
+
+static void free_reports(snap_report_t *r)
+{
+    while (r) {
+        snap_report_t *next = r->next;
+        node_free(r);
+        r = next;
+    }
+}
+
+uint64_t snap_begin(void)
+{
+    snap_thread_t *self = snap_self;
+    if (__builtin_expect(!self, 0))
+        self = snap_register();
+
+    /* reports that arrived after the previous range query ended */
+    free_reports(SWAP_PTR(&self->reports, NULL));
+
+    __atomic_fetch_add(&snap_active, 1, __ATOMIC_SEQ_CST);
+    uint64_t now = __atomic_load_n(&snap_clock, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&self->ts, now, __ATOMIC_SEQ_CST);
+    return __atomic_fetch_add(&snap_clock, 1, __ATOMIC_SEQ_CST);
+}
+
+static int compare_val(const void *a, const void *b)
+{
+    val_t x = *(const val_t *) a, y = *(const val_t *) b;
+    return (x > y) - (x < y);
+}
+
+int snap_end(uint64_t ts, val_t lo, val_t hi, val_t *buf, int n, int max)
+{
+    snap_thread_t *self = snap_self;
+    __atomic_store_n(&self->ts, SNAP_IDLE, __ATOMIC_SEQ_CST);
+    __atomic_fetch_sub(&snap_active, 1, __ATOMIC_SEQ_CST);
+    snap_report_t *reports = SWAP_PTR(&self->reports, NULL);
+    if (!reports)
+        return n;
+
+    /* keep the reported keys that belong to the snapshot */
+    int count = 0, capacity = 16;
+    val_t *keys = malloc(capacity * sizeof(val_t));
+    for (snap_report_t *r = reports; r; r = r->next) {
+        if (r->key < lo || r->key > hi || r->ins_ts > ts || r->del_ts <= ts)
+            continue;
+        if (count == capacity) {
+            capacity *= 2;
+            keys = realloc(keys, capacity * sizeof(val_t));
+        }
+        keys[count++] = r->key;
+    }
+    free_reports(reports);
+    qsort(keys, count, sizeof(val_t), compare_val);
+
+    /* merge them with the stored keys; a node may have been both reported
+     * and collected, and if keys were dropped for lack of room the count
+     * may be too high, but it stays above max.
+     */
+    int stored = n < max ? n : max;
+    val_t *merged = malloc((stored + count) * sizeof(val_t));
+    int i = 0, j = 0, m = 0, added = 0;
+    while (i < stored || j < count) {
+        if (j == count || (i < stored && buf[i] <= keys[j])) {
+            merged[m++] = buf[i++];
+        } else if (m && merged[m - 1] == keys[j]) {
+            j++;
+        } else {
+            merged[m++] = keys[j++];
+            added++;
+        }
+    }
+    memcpy(buf, merged, (m < max ? m : max) * sizeof(val_t));
+    free(merged);
+    free(keys);
+    return n + added;
+}
@@ -0,0 +1,218 @@
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "topology.h"
+
+#if !defined(CORE_NUM)
+#define CORE_NUM 4
+#endif
+
+#if !defined(CPU_SETSIZE)
+#define CPU_SETSIZE 1024
+#endif
+
+#define SYSFS_CPU "/sys/devices/system/cpu"
+#define SYSFS_NODE "/sys/devices/system/node"
+
+/* parse a cpu list such as "0-3,8,10-11" into at most max cpus.
+ * @return the number of cpus, or -1 if the list is malformed
+ */
+static int parse_cpu_list(const char *s, int *cpus, int max)
+{
+    int n = 0;
+    while (*s && *s != '\n') {
+        char *end;
+        long lo = strtol(s, &end, 10), hi = lo;
+        if (end == s || lo < 0)
+            return -1;
+        s = end;
+        if (*s == '-') {
+            hi = strtol(s + 1, &end, 10);
+            if (end == s + 1 || hi < lo)
+                return -1;
+            s = end;
+        }
+        for (long c = lo; c <= hi && n < max; c++)
+            cpus[n++] = (int) c;
+        if (*s == ',')
+            s++;
+        else if (*s && *s != '\n')
+            return -1;
+    }
+    return n;
+}
+
+/* read the first line of a sysfs file into buf; 0 on success */
+static int read_line(const char *path, char *buf, int size)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return -1;
+    int ok = fgets(buf, size, f) != NULL;
+    fclose(f);
+    return ok ? 0 : -1;
+}
+
+static int read_int(const char *path, int dflt)
+{
+    char buf[32];
+    return read_line(path, buf, sizeof(buf)) ? dflt : atoi(buf);
+}
+
+static int compare_cpu(const void *a, const void *b)
+{
+    return ((const cpu_info_t *) a)->cpu - ((const cpu_info_t *) b)->cpu;
+}
+
+int topology_read(cpu_info_t **cpus)
+{
+    static char line[4096];
+    int max = CPU_SETSIZE;
+    int *ids = malloc(max * sizeof(int));
+    int n = -1;
+    if (!read_line(SYSFS_CPU "/online", line, sizeof(line)))
+        n = parse_cpu_list(line, ids, max);
+
+    cpu_info_t *info;
+    if (n <= 0) {
+        n = CORE_NUM;
+        info = malloc(n * sizeof(cpu_info_t));
+        for (int i = 0; i < n; i++)
+            info[i] = (cpu_info_t){.cpu = i, .core = i};
+        free(ids);
+        *cpus = info;
+        return n;
+    }
+
+    info = malloc(n * sizeof(cpu_info_t));
+    for (int i = 0; i < n; i++) {
+        char path[128];
+        info[i] = (cpu_info_t){.cpu = ids[i]};
+        snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/topology/physical_package_id",
+                 ids[i]);
+        info[i].socket = read_int(path, 0);
+        snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/topology/core_id", ids[i]);
+        info[i].core = read_int(path, ids[i]);
+    }
+    qsort(info, n, sizeof(cpu_info_t), compare_cpu);
+
+    /* SMT siblings share a socket and a core id */
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < i; j++)
+            if (info[j].socket == info[i].socket && info[j].core == info[i].core)
+                info[i].smt++;
+
+    /* every node lists its cpus */
+    DIR *dir = opendir(SYSFS_NODE);
+    if (dir) {
+        struct dirent *e;
+        while ((e = readdir(dir))) {
+            int node;
+            char path[300];
+            if (sscanf(e->d_name, "node%d", &node) != 1)
+                continue;
+            snprintf(path, sizeof(path), SYSFS_NODE "/%s/cpulist", e->d_name);
+            if (read_line(path, line, sizeof(line)))
+                continue;
+            int m = parse_cpu_list(line, ids, max);
+            for (int k = 0; k < m; k++)
+                for (int i = 0; i < n; i++)
+                    if (info[i].cpu == ids[k])
+                        info[i].node = node;
+        }
+        closedir(dir);
+    }
+
+    free(ids);
+    *cpus = info;
+    return n;
+}
+
+/* rank of the core of each cpu among the cores of its socket, by core id */
+static int core_rank(const cpu_info_t *cpus, int n, int i)
+{
+    int rank = 0;
+    for (int j = 0; j < n; j++)
+        if (cpus[j].socket == cpus[i].socket && cpus[j].smt == 0 &&
+            cpus[j].core < cpus[i].core)
+            rank++;
+    return rank;
+}
+
+static int compare_compact(const void *a, const void *b)
+{
+    const cpu_info_t *x = a, *y = b;
+    if (x->socket != y->socket)
+        return x->socket - y->socket;
+    if (x->core != y->core)
+        return x->core - y->core;
+    return x->smt - y->smt;
+}
+
+int topology_place(int policy, const char *list, cpu_info_t **order)
+{
+    cpu_info_t *cpus;
+    int n = topology_read(&cpus);
+
+    if (policy == PIN_LIST) {
+        int *ids = malloc(CPU_SETSIZE * sizeof(int));
+        int m = parse_cpu_list(list, ids, CPU_SETSIZE);
+        cpu_info_t *placed = malloc((m > 0 ? m : 1) * sizeof(cpu_info_t));
+        for (int k = 0; k < m; k++) {
+            int i = 0;
+            while (i < n && cpus[i].cpu != ids[k])
+                i++;
+            if (i == n) { /* not online */
+                m = -1;
+                break;
+            }
+            placed[k] = cpus[i];
+        }
+        free(ids);
+        free(cpus);
+        if (m <= 0) {
+            free(placed);
+            return -1;
+        }
+        *order = placed;
+        return m;
+    }
+
+    if (policy == PIN_SCATTER) {
+        /* the k-th core of every socket, then the next one; siblings last */
+        int *key = malloc(n * sizeof(int));
+        for (int i = 0; i < n; i++)
+            key[i] = core_rank(cpus, n, i);
+        cpu_info_t *placed = malloc(n * sizeof(cpu_info_t));
+        int m = 0;
+        for (int smt = 0; m < n; smt++)
+            for (int rank = 0; rank < n && m < n; rank++)
+                for (int i = 0; i < n; i++)
+                    if (cpus[i].smt == smt && key[i] == rank)
+                        placed[m++] = cpus[i];
+        free(key);
+        free(cpus);
+        *order = placed;
+        return n;
+    }
+
+    qsort(cpus, n, sizeof(cpu_info_t), compare_compact);
+    *order = cpus;
+    return n;
+}
+
+int topology_pin(int cpu)
+{
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) ? -1 : 0;
+#else
+    return -1;
+#endif
+}
@@ -0,0 +1,99 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+#if !defined(MAP_POPULATE)
+#define MAP_POPULATE 0
+#endif
+
+int trace_open(trace_t *t, const char *path)
+{
+    memset(t, 0, sizeof(trace_t));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    t->size = st.st_size;
+    if (t->size < sizeof(trace_header_t)) {
+        fprintf(stderr, "%s: not a trace file\n", path);
+        close(fd);
+        return -1;
+    }
+
+    /* fault the whole trace in now rather than during the run */
+    t->map = mmap(NULL, t->size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (t->map == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+    t->header = t->map;
+    t->streams = (const trace_stream_t *) (t->header + 1);
+
+    const trace_header_t *h = t->header;
+    bool valid = !memcmp(h->magic, TRACE_MAGIC, sizeof(h->magic)) &&
+                 h->streams > 0 &&
+                 sizeof(trace_header_t) + h->streams * sizeof(trace_stream_t) <=
+                     t->size;
+    for (uint32_t i = 0; valid && i < h->streams; i++) {
+        const trace_stream_t *s = &t->streams[i];
+        valid = s->offset % sizeof(uint64_t) == 0 && s->prefill <= s->count &&
+                s->offset <= t->size &&
+                s->count <= (t->size - s->offset) / sizeof(uint64_t);
+    }
+    if (!valid) {
+        fprintf(stderr, "%s: not a valid trace file\n", path);
+        trace_close(t);
+        return -1;
+    }
+    return 0;
+}
+
+void trace_close(trace_t *t)
+{
+    if (t->map)
+        munmap(t->map, t->size);
+    t->map = NULL;
+}
+
+int trace_write(const char *path, trace_header_t *h, const trace_buf_t *bufs,
+                int n)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    memcpy(h->magic, TRACE_MAGIC, sizeof(h->magic));
+    h->streams = n;
+
+    bool ok = fwrite(h, sizeof(trace_header_t), 1, f) == 1;
+    uint64_t offset = sizeof(trace_header_t) + n * sizeof(trace_stream_t);
+    for (int i = 0; ok && i < n; i++) {
+        trace_stream_t s = {offset, bufs[i].prefill, bufs[i].count};
+        ok = fwrite(&s, sizeof(s), 1, f) == 1;
+        offset += bufs[i].count * sizeof(uint64_t);
+    }
+    for (int i = 0; ok && i < n; i++)
+        ok = fwrite(bufs[i].recs, sizeof(uint64_t), bufs[i].count, f) ==
+             bufs[i].count;
+    if (fclose(f) != 0)
+        ok = false;
+    if (!ok) {
+        perror(path);
+        return -1;
+    }
+    return 0;
+}
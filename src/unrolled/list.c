@@ -0,0 +1,259 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "alloc.h"
+#include "list.h"
+#include "reclaim.h"
+
+/* Unrolled list: each node fills one cache line and holds up to NODE_KEYS
+ * sorted keys, so a traversal touches NODE_KEYS times fewer lines than a list
+ * of single-key nodes.
+ *
+ * Every node has an immutable anchor and owns the keys in
+ * [anchor, next->anchor). Updates lock the owning node through its version
+ * number (odd while locked), validate that it still owns the key, and change
+ * it in place. A full node is split in two, and a node is merged with its
+ * successor when both fit in a node with room to spare. Readers take no
+ * locks: they read a node optimistically and retry if its version changed,
+ * and merged nodes are retired through the reclamation scheme.
+ */
+#define NODE_KEYS 5 /* with the 24-byte header, fills 64 bytes */
+#define MERGE_KEYS (NODE_KEYS * 2 / 3)
+
+struct node {
+    uint32_t version;  /* odd while locked, bumped by every update */
+    uint16_t count;    /* number of keys in use */
+    uint16_t deleted;  /* merged into its predecessor */
+    struct node *next;
+    val_t anchor;      /* lower bound of the keys of the node */
+    val_t keys[NODE_KEYS];
+} ALIGNED(64);
+
+STATIC_ASSERT(sizeof(node_t) == 64, "a node must fit a cache line");
+
+struct list {
+    node_t *head;
+    uint32_t size;
+};
+
+static inline uint32_t node_lock(node_t *node)
+{
+    while (1) {
+        uint32_t v = __atomic_load_n(&node->version, __ATOMIC_RELAXED);
+        if (!(v & 1) && CAS_U32(&node->version, v, v + 1) == v)
+            return v + 1;
+        cpu_relax();
+    }
+}
+
+static inline void node_unlock(node_t *node)
+{
+    __atomic_store_n(&node->version, node->version + 1, __ATOMIC_RELEASE);
+}
+
+/* wait until the node is not locked and return its version */
+static inline uint32_t read_begin(node_t *node)
+{
+    uint32_t v;
+    while ((v = __atomic_load_n(&node->version, __ATOMIC_ACQUIRE)) & 1)
+        cpu_relax();
+    return v;
+}
+
+/* true if nothing changed the node since read_begin returned v */
+static inline bool read_validate(node_t *node, uint32_t v)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&node->version, __ATOMIC_RELAXED) == v;
+}
+
+/* the first node whose successor does not start at or below val; it owns val
+ * unless it was merged in the meantime, which the caller has to check.
+ */
+static inline node_t *list_locate(list_t *the_list, val_t val)
+{
+    node_t *node = the_list->head;
+    while (1) {
+        node_t *next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+        if (!next || next->anchor > val)
+            return node;
+        node = next;
+    }
+}
+
+/* lock the node owning val */
+static node_t *lock_owner(list_t *the_list, val_t val)
+{
+    while (1) {
+        node_t *node = list_locate(the_list, val);
+        node_lock(node);
+        if (!node->deleted && (!node->next || node->next->anchor > val))
+            return node;
+        node_unlock(node); /* split or merged in between, start over */
+    }
+}
+
+/* index of the first key of the node not lower than val */
+static inline int node_find(node_t *node, val_t val)
+{
+    int i = 0;
+    while (i < node->count && node->keys[i] < val)
+        i++;
+    return i;
+}
+
+/* return true if there is a node in the list owning value val. */
+bool list_contains(list_t *the_list, val_t val)
+{
+    bool found;
+    reclaim_enter();
+    node_t *node = list_locate(the_list, val);
+    while (1) {
+        uint32_t v = read_begin(node);
+        node_t *next = __atomic_load_n(&node->next, __ATOMIC_RELAXED);
+        uint32_t count = __atomic_load_n(&node->count, __ATOMIC_RELAXED);
+        bool deleted = __atomic_load_n(&node->deleted, __ATOMIC_RELAXED);
+        found = false;
+        for (uint32_t i = 0; i < count && i < NODE_KEYS; i++) {
+            val_t key = __atomic_load_n(&node->keys[i], __ATOMIC_RELAXED);
+            if (key >= val) {
+                found = key == val;
+                break;
+            }
+        }
+        if (!read_validate(node, v))
+            continue;
+        if (deleted) {
+            node = list_locate(the_list, val);
+            continue;
+        }
+        if (next && next->anchor <= val) { /* split since we located it */
+            node = next;
+            continue;
+        }
+        break;
+    }
+    reclaim_exit();
+    return found;
+}
+
+static node_t *new_node(val_t anchor, node_t *next)
+{
+    node_t *node = node_alloc(sizeof(node_t));
+    node->version = 0;
+    node->count = 0;
+    node->deleted = 0;
+    node->next = next;
+    node->anchor = anchor;
+    return node;
+}
+
+list_t *list_new()
+{
+    /* allocate list */
+    list_t *the_list = malloc(sizeof(list_t));
+
+    /* the head node owns every key until it is split */
+    the_list->head = new_node(VAL_MIN, NULL);
+    the_list->size = 0;
+    return the_list;
+}
+
+/* free the list and all the nodes still linked in it; the caller must make
+ * sure no other thread is operating on the list.
+ */
+void list_delete(list_t *the_list)
+{
+    node_t *elem = the_list->head;
+    while (elem) {
+        node_t *next = elem->next;
+        node_free(elem);
+        elem = next;
+    }
+    free(the_list);
+}
+
+int list_size(list_t *the_list)
+{
+    return the_list->size;
+}
+
+bool list_add(list_t *the_list, val_t val)
+{
+    reclaim_enter();
+    node_t *node = lock_owner(the_list, val);
+    int i = node_find(node, val);
+    if (i < node->count && node->keys[i] == val) {
+        node_unlock(node);
+        reclaim_exit();
+        return false;
+    }
+
+    node_t *target = node;
+    node_t *split = NULL;
+    if (node->count == NODE_KEYS) {
+        /* split: move the upper half to a new node, which is only linked
+         * once it is complete, and insert val in the half that owns it.
+         */
+        int half = NODE_KEYS / 2;
+        split = new_node(node->keys[half], node->next);
+        for (int j = half; j < NODE_KEYS; j++)
+            split->keys[j - half] = node->keys[j];
+        split->count = NODE_KEYS - half;
+        node->count = half;
+        if (i > half) {
+            target = split;
+            i -= half;
+        }
+    }
+
+    for (int j = target->count; j > i; j--)
+        target->keys[j] = target->keys[j - 1];
+    target->keys[i] = val;
+    target->count++;
+    if (split)
+        __atomic_store_n(&node->next, split, __ATOMIC_RELEASE);
+    node_unlock(node);
+    FAI_U32(&(the_list->size));
+    reclaim_exit();
+    return true;
+}
+
+bool list_remove(list_t *the_list, val_t val)
+{
+    reclaim_enter();
+    node_t *node = lock_owner(the_list, val);
+    int i = node_find(node, val);
+    if (i == node->count || node->keys[i] != val) {
+        node_unlock(node);
+        reclaim_exit();
+        return false;
+    }
+
+    for (int j = i; j < node->count - 1; j++)
+        node->keys[j] = node->keys[j + 1];
+    node->count--;
+
+    /* merge the successor in, locking left to right as the updates do */
+    node_t *next = node->next;
+    node_t *merged = NULL;
+    if (next && node->count + next->count <= MERGE_KEYS) {
+        node_lock(next);
+        if (node->count + next->count <= MERGE_KEYS) {
+            for (int j = 0; j < next->count; j++)
+                node->keys[node->count + j] = next->keys[j];
+            node->count += next->count;
+            next->deleted = 1;
+            __atomic_store_n(&node->next, next->next, __ATOMIC_RELEASE);
+            merged = next;
+        }
+        node_unlock(next);
+    }
+    node_unlock(node);
+    FAD_U32(&(the_list->size));
+    if (merged)
+        reclaim_retire(merged);
+    reclaim_exit();
+    return true;
+}